@@ -1 +0,0 @@
-docker build -t collector:v1 .
\ No newline at end of file
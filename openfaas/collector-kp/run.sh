@@ -1 +0,0 @@
-docker run -itd collector:v1
\ No newline at end of file
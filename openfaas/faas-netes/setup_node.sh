@@ -1 +1 @@
-mkdir -p /home/tank/lijie/serving_locks/ && mkdir -p /dev/shm/serving_memorys/ && mkdir -p /home/tank/lijie/serving_models/
\ No newline at end of file
+mkdir -p /dev/shm/serving_memorys/ && mkdir -p /home/tank/lijie/serving_models/
\ No newline at end of file
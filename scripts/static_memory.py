@@ -16,7 +16,7 @@ def construct_run_cmd(model_name,cpus):
     cpu_para = ""
     # volume_para = "-v /home/tank/lijie/change_model/"+model_name+":/models/"+model_name
     volume_para = "-v " + MODEL_PATH + "/" + model_name + ":/models/" + model_name
-    volume_para = volume_para + " -v /dev/shm/serving_memorys/:/dev/shm/serving_memorys/ -v /home/tank/lijie/serving_locks/:/home/tank/lijie/serving_locks/"
+    volume_para = volume_para + " -v /dev/shm/serving_memorys/:/dev/shm/serving_memorys/"
     model_name_para = "-e MODEL_NAME="+model_name
     # runtime_image_para = "tensorflow/serving:2.4.1"
     runtime_image_para = IMAGE
@@ -134,6 +134,10 @@ class SimpleLoader : public Loader {
  private:
   Status EstimateResourcesPostLoad();
 
+  // Returns the main memory of 'estimate', private and shared alike, so that
+  // moving bytes between the two does not look like a change in footprint.
+  uint64 GetRamQuantity(const ResourceAllocation& estimate) const;
+
   CreatorVariant creator_variant_;
 
   // A function that estimates the resources needed to load the servable.
@@ -323,10 +327,10 @@ Status SimpleLoader<ServableType>::EstimateResourcesPostLoad() {
     memoized_resource_estimate_ = post_load_resource_estimate;
 
     // Release any transient memory used only during load to the OS.
-    const uint64 during_load_ram_estimate = resource_util_->GetQuantity(
-        ram_resource_, during_load_resource_estimate);
+    const uint64 during_load_ram_estimate =
+        GetRamQuantity(during_load_resource_estimate);
     const uint64 post_load_ram_estimate =
-        resource_util_->GetQuantity(ram_resource_, post_load_resource_estimate);
+        GetRamQuantity(post_load_resource_estimate);
     if (post_load_ram_estimate < during_load_ram_estimate) {
       const uint64 transient_ram_estimate =
           during_load_ram_estimate - post_load_ram_estimate;
@@ -341,6 +345,20 @@ Status SimpleLoader<ServableType>::EstimateResourcesPostLoad() {
   return Status::OK();
 }
 
+template <typename ServableType>
+uint64 SimpleLoader<ServableType>::GetRamQuantity(
+    const ResourceAllocation& estimate) const {
+  uint64 quantity = resource_util_->GetQuantity(ram_resource_, estimate);
+  for (const ResourceAllocation::SharedEntry& shared_entry :
+       estimate.shared_resource_quantities()) {
+    if (resource_util_->ResourcesEqual(shared_entry.resource(),
+                                       ram_resource_)) {
+      quantity += shared_entry.quantity();
+    }
+  }
+  return quantity;
+}
+
 template <typename ServableType>
 void SimpleLoader<ServableType>::Unload() {
   // Before destroying the servable, run the resource estimator (in case the
@@ -199,7 +199,36 @@ int main(int argc, char** argv) {
           "enable_signature_method_name_check",
           &options.enable_signature_method_name_check,
           "Enable method_name check for SignatureDef. Disable this if serving "
-          "native TF2 regression/classification models.")};
+          "native TF2 regression/classification models."),
+      tensorflow::Flag("enable_shared_tensors", &options.enable_shared_tensors,
+                       "Restore the tensors of the models into the shared "
+                       "tensor arena of the node, sharing them with the other "
+                       "model servers. Can be overridden per model with the "
+                       "shared_tensor_config of the model config file, "
+                       "except for the constants shared under "
+                       "TF_SHARED_CONSTANT_MIN_BYTES, which only this flag "
+                       "turns off."),
+      tensorflow::Flag("shared_tensor_min_bytes",
+                       &options.shared_tensor_min_bytes,
+                       "Tensors smaller than this are restored into private "
+                       "memory."),
+      tensorflow::Flag("fail_if_tensors_not_shared",
+                       &options.fail_if_tensors_not_shared,
+                       "Fail the load of a model if one of its tensors can not "
+                       "be shared, instead of restoring it into private "
+                       "memory."),
+      tensorflow::Flag("shared_tensor_arena_socket",
+                       &options.shared_tensor_arena_socket,
+                       "If non-empty, get the shared tensor arena from the "
+                       "shared_tensor_daemon listening on this socket."),
+      tensorflow::Flag("shared_tensor_arena_path",
+                       &options.shared_tensor_arena_path,
+                       "If non-empty, the path of the shared tensor arena "
+                       "file."),
+      tensorflow::Flag("shared_tensor_arena_capacity_bytes",
+                       &options.shared_tensor_arena_capacity_bytes,
+                       "If positive, the size of the shared tensor arena, "
+                       "when this server creates it.")};
 
   const auto& usage = tensorflow::Flags::Usage(argv[0], flag_list);
   if (!tensorflow::Flags::Parse(&argc, argv, flag_list)) {
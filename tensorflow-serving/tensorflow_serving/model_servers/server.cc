@@ -42,6 +42,7 @@ limitations under the License.
 #include "tensorflow_serving/config/model_server_config.pb.h"
 #include "tensorflow_serving/config/monitoring_config.pb.h"
 #include "tensorflow_serving/config/platform_config.pb.h"
+#include "tensorflow_serving/config/shared_tensor_config.pb.h"
 #include "tensorflow_serving/config/ssl_config.pb.h"
 #include "tensorflow_serving/core/availability_preserving_policy.h"
 #include "tensorflow_serving/model_servers/grpc_status_util.h"
@@ -291,6 +292,19 @@ Status Server::BuildAndStart(const Options& server_options) {
   options.flush_filesystem_caches = server_options.flush_filesystem_caches;
   options.allow_version_labels_for_unavailable_models =
       server_options.allow_version_labels_for_unavailable_models;
+  options.shared_tensor_config.mutable_enabled()->set_value(
+      server_options.enable_shared_tensors);
+  options.shared_tensor_config.set_min_tensor_bytes(
+      server_options.shared_tensor_min_bytes);
+  options.shared_tensor_config.set_fallback_policy(
+      server_options.fail_if_tensors_not_shared
+          ? SharedTensorConfig::FAIL_LOAD
+          : SharedTensorConfig::RESTORE_PRIVATELY);
+  options.shared_tensor_arena_socket =
+      server_options.shared_tensor_arena_socket;
+  options.shared_tensor_arena_path = server_options.shared_tensor_arena_path;
+  options.shared_tensor_arena_capacity_bytes =
+      server_options.shared_tensor_arena_capacity_bytes;
 
   TF_RETURN_IF_ERROR(ServerCore::Create(std::move(options), &server_core_));
 
@@ -87,6 +87,12 @@ class Server {
     bool prefer_tflite_model = false;
     tensorflow::string thread_pool_factory_config_file;
     bool enable_signature_method_name_check = false;
+    bool enable_shared_tensors = true;
+    tensorflow::int64 shared_tensor_min_bytes = 0;
+    bool fail_if_tensors_not_shared = false;
+    tensorflow::string shared_tensor_arena_socket;
+    tensorflow::string shared_tensor_arena_path;
+    tensorflow::int64 shared_tensor_arena_capacity_bytes = 0;
 
     Options();
   };
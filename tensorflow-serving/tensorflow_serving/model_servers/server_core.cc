@@ -23,7 +23,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
 #include "tensorflow_serving/core/load_servables_fast.h"
 #include "tensorflow_serving/model_servers/model_platform_types.h"
 #include "tensorflow_serving/resources/resource_values.h"
@@ -214,6 +216,19 @@ Status UpdateModelConfigListRelativePaths(
   return Status::OK();
 }
 
+// Returns the shared tensor policy configured by 'config'.
+SharedTensorPolicy SharedTensorPolicyFromConfig(
+    const SharedTensorConfig& config) {
+  SharedTensorPolicy policy;
+  if (config.has_enabled()) {
+    policy.enabled = config.enabled().value();
+  }
+  policy.min_tensor_bytes = config.min_tensor_bytes();
+  policy.fail_if_not_shared =
+      config.fallback_policy() == SharedTensorConfig::FAIL_LOAD;
+  return policy;
+}
+
 }  // namespace
 
 // ************************************************************************
@@ -236,6 +251,30 @@ Status ServerCore::Create(Options options,
         ServerRequestLogger::Create(nullptr, &options.server_request_logger));
   }
 
+  if (!options.shared_tensor_arena_socket.empty() ||
+      !options.shared_tensor_arena_path.empty() ||
+      options.shared_tensor_arena_capacity_bytes > 0) {
+    // The environment still sets whatever the options leave unset, e.g. the
+    // huge pages.
+    SharedTensorArena::Options arena_options;
+    string socket_path;
+    SharedTensorArena::GlobalOptionsFromEnv(&arena_options, &socket_path);
+    if (!options.shared_tensor_arena_socket.empty()) {
+      socket_path = options.shared_tensor_arena_socket;
+    } else if (!options.shared_tensor_arena_path.empty()) {
+      // Opening the given path, not a daemon socket of the environment.
+      socket_path.clear();
+    }
+    if (!options.shared_tensor_arena_path.empty()) {
+      arena_options.path = options.shared_tensor_arena_path;
+    }
+    if (options.shared_tensor_arena_capacity_bytes > 0) {
+      arena_options.capacity_bytes = options.shared_tensor_arena_capacity_bytes;
+    }
+    TF_RETURN_IF_ERROR(
+        SharedTensorArena::ConfigureGlobal(arena_options, socket_path));
+  }
+
   // We need to move the aspired_version_policy first because we will move the
   // server_core_config (which contains aspired_version_policy) below.
   std::unique_ptr<AspiredVersionPolicy> aspired_version_policy =
@@ -406,6 +445,31 @@ Status ServerCore::AddModelsViaCustomModelConfig() {
       config_.custom_model_config(), servable_event_bus_.get(), &manager_);
 }
 
+void ServerCore::UpdateSharedTensorPolicies() {
+  SetSharedTensorPolicy(
+      "", SharedTensorPolicyFromConfig(options_.shared_tensor_config));
+  for (const string& path : shared_tensor_policy_paths_) {
+    ClearSharedTensorPolicy(path);
+  }
+  shared_tensor_policy_paths_.clear();
+  if (config_.config_case() != ModelServerConfig::kModelConfigList) return;
+  for (const auto& model_config : config_.model_config_list().config()) {
+    if (model_config.has_shared_tensor_config()) {
+      // The bundles are restored from the base path as prefixed by the
+      // PrefixStoragePathSourceAdapter, see CreateStoragePathSource().
+      const string path =
+          options_.storage_path_prefix.empty()
+              ? model_config.base_path()
+              : io::JoinPath(options_.storage_path_prefix,
+                             model_config.base_path());
+      SetSharedTensorPolicy(
+          path,
+          SharedTensorPolicyFromConfig(model_config.shared_tensor_config()));
+      shared_tensor_policy_paths_.push_back(path);
+    }
+  }
+}
+
 Status ServerCore::MaybeUpdateServerRequestLogger(
     const ModelServerConfig::ConfigCase config_case) {
   if (options_.server_request_logger_updater) {
@@ -469,6 +533,7 @@ Status ServerCore::ReloadConfig(const ModelServerConfig& new_config) {
             *options_.model_config_list_root_dir,
             config_.mutable_model_config_list()));
       }
+      UpdateSharedTensorPolicies();
       TF_RETURN_IF_ERROR(AddModelsViaModelConfigList());
       break;
     }
@@ -476,6 +541,7 @@ Status ServerCore::ReloadConfig(const ModelServerConfig& new_config) {
       // We've already verified this invariant above, so this check should
       // always pass.
       CHECK(is_first_config);  // Crash ok.
+      UpdateSharedTensorPolicies();
       TF_RETURN_IF_ERROR(AddModelsViaCustomModelConfig());
       break;
     }
@@ -21,6 +21,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "google/protobuf/any.pb.h"
 #include "absl/base/macros.h"
@@ -34,6 +35,7 @@ limitations under the License.
 #include "tensorflow_serving/config/logging_config.pb.h"
 #include "tensorflow_serving/config/model_server_config.pb.h"
 #include "tensorflow_serving/config/platform_config.pb.h"
+#include "tensorflow_serving/config/shared_tensor_config.pb.h"
 #include "tensorflow_serving/core/aspired_versions_manager.h"
 #include "tensorflow_serving/core/dynamic_source_router.h"
 #include "tensorflow_serving/core/prefix_storage_path_source_adapter.h"
@@ -190,6 +192,19 @@ class ServerCore : public Manager {
 
     // The prefix to append to the file system storage paths.
     std::string storage_path_prefix;
+
+    // How the tensors of the models are shared with the other model servers
+    // of the node, unless their ModelConfig has a shared_tensor_config.
+    SharedTensorConfig shared_tensor_config;
+
+    // The shared tensor arena of the node: the socket of the
+    // shared_tensor_daemon to get it from, or else the path of the arena file
+    // and the size it is created with (zero for the default). What is left
+    // unset, e.g. the huge pages, is taken from the TF_SHARED_TENSOR_*
+    // environment variables.
+    std::string shared_tensor_arena_socket;
+    std::string shared_tensor_arena_path;
+    int64 shared_tensor_arena_capacity_bytes = 0;
   };
 
   virtual ~ServerCore() = default;
@@ -365,6 +380,10 @@ class ServerCore : public Manager {
   Status AddModelsViaCustomModelConfig()
       TF_EXCLUSIVE_LOCKS_REQUIRED(config_mu_);
 
+  // Sets the shared tensor policies of the models of 'config_', and of those
+  // of custom model configs.
+  void UpdateSharedTensorPolicies() TF_EXCLUSIVE_LOCKS_REQUIRED(config_mu_);
+
   // Updates the ServerRequestLogger based on the ModelConfigList.
   Status MaybeUpdateServerRequestLogger(
       ModelServerConfig::ConfigCase config_case)
@@ -432,6 +451,9 @@ class ServerCore : public Manager {
   absl::optional<StoragePathSourceAndRouter> storage_path_source_and_router_
       TF_GUARDED_BY(config_mu_);
 
+  // The base paths of the models with a shared tensor policy of their own.
+  std::vector<string> shared_tensor_policy_paths_ TF_GUARDED_BY(config_mu_);
+
   // A mutex for reconfiguration, used by ReloadConfig().
   mutable mutex config_mu_;
 
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
 #include "tensorflow_serving/apis/model.pb.h"
 #include "tensorflow_serving/apis/predict.pb.h"
 #include "tensorflow_serving/core/servable_handle.h"
@@ -187,6 +188,56 @@ TEST_P(ServerCoreTest, ReloadConfigChangeModelBasePath) {
            available_servables.at(0).version != test_util::kTestModelVersion);
 }
 
+TEST_P(ServerCoreTest, ReloadConfigSetsSharedTensorPolicies) {
+  ModelServerConfig config = GetTestModelServerConfigForFakePlatform();
+  ModelConfig* model_config =
+      config.mutable_model_config_list()->mutable_config(0);
+  const string base_path = model_config->base_path();
+  model_config->mutable_shared_tensor_config()->mutable_enabled()->set_value(
+      false);
+
+  std::unique_ptr<ServerCore> server_core;
+  TF_ASSERT_OK(CreateServerCore(config, &server_core));
+  EXPECT_FALSE(
+      GetSharedTensorPolicy(io::JoinPath(base_path, "1/variables/variables"))
+          .enabled);
+
+  model_config->clear_shared_tensor_config();
+  TF_ASSERT_OK(server_core->ReloadConfig(config));
+  EXPECT_TRUE(
+      GetSharedTensorPolicy(io::JoinPath(base_path, "1/variables/variables"))
+          .enabled);
+}
+
+TEST_P(ServerCoreTest, SharedTensorPoliciesUseStoragePathPrefix) {
+  if (PrefixPathsWithURIScheme()) {
+    return;
+  }
+
+  // Move the directory of the model base path to the storage path prefix.
+  ModelServerConfig config = GetTestModelServerConfigForFakePlatform();
+  ModelConfig* model_config =
+      config.mutable_model_config_list()->mutable_config(0);
+  const string base_path = model_config->base_path();
+  model_config->set_base_path(string(io::Basename(base_path)));
+  model_config->mutable_shared_tensor_config()->mutable_enabled()->set_value(
+      false);
+  ServerCore::Options options = GetDefaultOptions();
+  options.storage_path_prefix = string(io::Dirname(base_path));
+
+  std::unique_ptr<ServerCore> server_core;
+  TF_ASSERT_OK(CreateServerCore(config, std::move(options), &server_core));
+  EXPECT_FALSE(
+      GetSharedTensorPolicy(io::JoinPath(base_path, "1/variables/variables"))
+          .enabled);
+
+  model_config->clear_shared_tensor_config();
+  TF_ASSERT_OK(server_core->ReloadConfig(config));
+  EXPECT_TRUE(
+      GetSharedTensorPolicy(io::JoinPath(base_path, "1/variables/variables"))
+          .enabled);
+}
+
 class RelativePathsServerCoreTest : public ServerCoreTest {
  protected:
   // Creates a ModelServerConfig instance where the directory name has
@@ -44,15 +44,20 @@ Status ResourceTracker::ReserveResources(const Loader& servable,
                                          bool* success) {
   ResourceAllocation servable_resources;
   TF_RETURN_IF_ERROR(servable.EstimateResources(&servable_resources));
-  TF_RETURN_IF_ERROR(util_->VerifyValidity(servable_resources));
+  ResourceAllocation charged_resources;
+  std::vector<string> new_shared_keys;
+  TF_RETURN_IF_ERROR(ChargeSharedResources(
+      servable_resources, &charged_resources, &new_shared_keys));
 
   ResourceAllocation conservative_proposed_used_resources =
       util_->Overbind(used_resources_);
-  util_->Add(servable_resources, &conservative_proposed_used_resources);
+  util_->Add(charged_resources, &conservative_proposed_used_resources);
 
   if (util_->LessThanOrEqual(conservative_proposed_used_resources,
                              total_resources_)) {
-    util_->Add(servable_resources, &used_resources_);
+    util_->Add(charged_resources, &used_resources_);
+    charged_shared_keys_.insert(new_shared_keys.begin(),
+                                new_shared_keys.end());
     *success = true;
   } else {
     LOG(WARNING) << "Insufficient resources to load servable "
@@ -61,7 +66,7 @@ Status ResourceTracker::ReserveResources(const Loader& servable,
                  << "used/reserved resources:\n"
                  << used_resources_.DebugString()
                  << "resources requested by servable:\n"
-                 << servable_resources.DebugString();
+                 << charged_resources.DebugString();
     *success = false;
   }
 
@@ -71,11 +76,43 @@ Status ResourceTracker::ReserveResources(const Loader& servable,
 Status ResourceTracker::RecomputeUsedResources(
     const std::vector<const Loader*>& servables) {
   used_resources_.Clear();
+  charged_shared_keys_.clear();
   for (const Loader* servable : servables) {
     ResourceAllocation servable_resources;
     TF_RETURN_IF_ERROR(servable->EstimateResources(&servable_resources));
-    TF_RETURN_IF_ERROR(util_->VerifyValidity(servable_resources));
-    util_->Add(servable_resources, &used_resources_);
+    ResourceAllocation charged_resources;
+    std::vector<string> new_shared_keys;
+    TF_RETURN_IF_ERROR(ChargeSharedResources(
+        servable_resources, &charged_resources, &new_shared_keys));
+    util_->Add(charged_resources, &used_resources_);
+    charged_shared_keys_.insert(new_shared_keys.begin(),
+                                new_shared_keys.end());
+  }
+  return Status::OK();
+}
+
+Status ResourceTracker::ChargeSharedResources(
+    const ResourceAllocation& servable_resources,
+    ResourceAllocation* charged_resources,
+    std::vector<string>* new_shared_keys) const {
+  TF_RETURN_IF_ERROR(util_->VerifyValidity(servable_resources));
+  *charged_resources->mutable_resource_quantities() =
+      servable_resources.resource_quantities();
+  std::unordered_set<string> seen_keys;
+  for (const auto& shared_entry :
+       servable_resources.shared_resource_quantities()) {
+    TF_RETURN_IF_ERROR(util_->VerifyResourceValidity(shared_entry.resource()));
+    if (charged_shared_keys_.count(shared_entry.key()) > 0 ||
+        !seen_keys.insert(shared_entry.key()).second) {
+      continue;
+    }
+    ResourceAllocation shared_resources;
+    ResourceAllocation::Entry* entry =
+        shared_resources.add_resource_quantities();
+    *entry->mutable_resource() = shared_entry.resource();
+    entry->set_quantity(shared_entry.quantity());
+    util_->Add(shared_resources, charged_resources);
+    new_shared_keys->push_back(shared_entry.key());
   }
   return Status::OK();
 }
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_SERVING_RESOURCES_RESOURCE_TRACKER_H_
 
 #include <memory>
+#include <unordered_set>
 #include <vector>
 
 #include "tensorflow_serving/core/loader.h"
@@ -39,6 +40,7 @@ class ResourceTracker {
 
   // Determines whether enough resources are available to load 'servable', i.e.
   // is it guaranteed to fit in the gap between the used and total resources?
+  // Shared resource quantities whose key is already charged for are free.
   // If so, adds the servable's resource allocation to the used resources and
   // sets 'success' to true. Otherwise, leaves the used resources unchanged and
   // sets 'success' to false. Upon encountering illegal data, e.g. if 'servable'
@@ -61,6 +63,13 @@ class ResourceTracker {
   ResourceTracker(const ResourceAllocation& total_resources,
                   std::unique_ptr<ResourceUtil> util);
 
+  // Verifies 'servable_resources', and returns its resource quantities plus
+  // those of its shared entries not charged for yet. Appends the keys of the
+  // latter to 'new_shared_keys'.
+  Status ChargeSharedResources(const ResourceAllocation& servable_resources,
+                               ResourceAllocation* charged_resources,
+                               std::vector<string>* new_shared_keys) const;
+
   // A ResourceUtil object to use for operations and comparisons on allocations.
   const std::unique_ptr<ResourceUtil> util_;
 
@@ -74,6 +83,9 @@ class ResourceTracker {
   // Under normal conditions, less than or equal to 'total_resources_'.
   ResourceAllocation used_resources_;
 
+  // The keys of the shared resource quantities included in 'used_resources_'.
+  std::unordered_set<string> charged_shared_keys_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(ResourceTracker);
 };
 
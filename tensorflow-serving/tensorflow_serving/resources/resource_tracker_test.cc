@@ -441,6 +441,63 @@ TEST_F(ResourceTrackerTest, ReserveResourcesFailureWithUsedResourcesUnbound) {
   EXPECT_THAT(tracker_->total_resources(), EqualsProto(total_resources_));
 }
 
+TEST_F(ResourceTrackerTest, SharedResourcesChargedOnce) {
+  // Two versions of a model sharing most of their weights.
+  const auto estimate = CreateProto<ResourceAllocation>(
+      "resource_quantities { "
+      "  resource { "
+      "    device: 'main' "
+      "    kind: 'ram' "
+      "  } "
+      "  quantity: 2 "
+      "} "
+      "shared_resource_quantities { "
+      "  key: 'weights' "
+      "  resource { "
+      "    device: 'main' "
+      "    kind: 'ram' "
+      "  } "
+      "  quantity: 10 "
+      "} ");
+  NiceMock<test_util::MockLoader> version_1, version_2;
+  for (auto* loader : {&version_1, &version_2}) {
+    ON_CALL(*loader, EstimateResources(_))
+        .WillByDefault(Invoke([&estimate](ResourceAllocation* actual) {
+          *actual = estimate;
+          return Status::OK();
+        }));
+  }
+
+  bool success;
+  TF_ASSERT_OK(tracker_->ReserveResources(version_1, &success));
+  EXPECT_TRUE(success);
+  TF_ASSERT_OK(tracker_->ReserveResources(version_2, &success));
+  EXPECT_TRUE(success);
+  const char* const expected_used_resources =
+      "resource_quantities { "
+      "  resource { "
+      "    device: 'main' "
+      "    device_instance { value: 0 } "
+      "    kind: 'ram' "
+      "  } "
+      "  quantity: 14 "
+      "} ";
+  EXPECT_THAT(tracker_->used_resources(),
+              EqualsProto(expected_used_resources));
+
+  TF_ASSERT_OK(tracker_->RecomputeUsedResources({&version_1, &version_2}));
+  EXPECT_THAT(tracker_->used_resources(),
+              EqualsProto(expected_used_resources));
+
+  // Once the servables sharing them are gone, the shared resources are charged
+  // again.
+  TF_ASSERT_OK(tracker_->RecomputeUsedResources({}));
+  TF_ASSERT_OK(tracker_->ReserveResources(*loader_2_, &success));
+  EXPECT_TRUE(success);
+  TF_ASSERT_OK(tracker_->ReserveResources(version_1, &success));
+  EXPECT_FALSE(success);
+}
+
 TEST_F(ResourceTrackerTest, InvalidResourceEstimate) {
   bool success;
   EXPECT_FALSE(
@@ -15,9 +15,13 @@ limitations under the License.
 
 #include "tensorflow_serving/servables/tensorflow/util.h"
 
+#include <algorithm>
 #include <atomic>
+#include <unordered_set>
+#include <vector>
 
 #include "google/protobuf/wrappers.pb.h"
+#include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -26,10 +30,13 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/cord.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/threadpool_options.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/tensor_bundle/naming.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
 #include "tensorflow_serving/apis/input.pb.h"
 #include "tensorflow_serving/apis/internal/serialized_input.pb.h"
 #include "tensorflow_serving/apis/model.pb.h"
@@ -288,8 +295,23 @@ Status EstimateResourceFromPathUsingDiskState(const string& path,
   uint64 total_file_size = 0;
   TF_RETURN_IF_ERROR(GetModelDiskSize(path, env, &total_file_size));
 
+  // Estimating must not open the arena.  Until a servable of this process
+  // restored into it, nothing is shared yet.
+  uint64 shared_file_bytes = 0;
+  if (SharedTensorArena::GlobalIfOpen() != nullptr) {
+    const Status status =
+        EstimateSharedTensorResources(path, estimate, &shared_file_bytes);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to estimate the shared memory of " << path
+                   << ", charging it all as private memory: " << status;
+      estimate->clear_shared_resource_quantities();
+      shared_file_bytes = 0;
+    }
+  }
+
   const uint64 ram_requirement =
-      total_file_size * kResourceEstimateRAMMultiplier +
+      (total_file_size - std::min(shared_file_bytes, total_file_size)) *
+          kResourceEstimateRAMMultiplier +
       kResourceEstimateRAMPadBytes;
 
   ResourceAllocation::Entry* ram_entry = estimate->add_resource_quantities();
@@ -301,6 +323,41 @@ Status EstimateResourceFromPathUsingDiskState(const string& path,
   return Status::OK();
 }
 
+Status EstimateSharedTensorResources(const string& path,
+                                     ResourceAllocation* estimate,
+                                     uint64* shared_file_bytes) {
+  *shared_file_bytes = 0;
+  const string variables_prefix = io::JoinPath(
+      path, kSavedModelVariablesDirectory, kSavedModelVariablesFilename);
+  if (!Env::Default()->FileExists(MetaFilename(variables_prefix)).ok()) {
+    // No variables, or not a saved model.
+    return Status::OK();
+  }
+  std::vector<SharedTensorInfo> tensors;
+  TF_RETURN_IF_ERROR(
+      ListSharedTensors(Env::Default(), variables_prefix, &tensors));
+
+  uint64 charged_bytes = 0;
+  std::unordered_set<string> keys;
+  for (const SharedTensorInfo& tensor : tensors) {
+    *shared_file_bytes += tensor.num_bytes;
+    // Identical tensors of the model restore into the same segment.
+    if (!keys.insert(tensor.key).second) continue;
+    ResourceAllocation::SharedEntry* shared_entry =
+        estimate->add_shared_resource_quantities();
+    shared_entry->set_key(tensor.key);
+    Resource* ram_resource = shared_entry->mutable_resource();
+    ram_resource->set_device(device_types::kMain);
+    ram_resource->set_kind(resource_kinds::kRamBytes);
+    shared_entry->set_quantity(tensor.num_bytes);
+    charged_bytes += tensor.num_bytes;
+  }
+  VLOG(1) << "Shared tensors of " << path << ": " << tensors.size()
+          << " tensors, " << *shared_file_bytes << " bytes, of which "
+          << charged_bytes << " bytes in distinct segments";
+  return Status::OK();
+}
+
 void RecordRuntimeLatency(const string& model_name, const string& api,
                           const string& runtime, int64 latency_usec) {
   runtime_latency->GetCell(model_name, api, runtime)->Add(latency_usec);
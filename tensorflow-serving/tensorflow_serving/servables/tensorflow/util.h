@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_SERVING_SERVABLES_TENSORFLOW_UTIL_H_
 
 #include "absl/types/optional.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
@@ -105,11 +106,24 @@ Status GetModelDiskSize(const string& path, FileProbingEnv* env,
 
 // Estimates the resources a session bundle or saved model bundle will use once
 // loaded, from its export or saved model path. Directly uses disk state for
-// estimation.
+// estimation. The tensors restored into the node-wide shared tensor arena, if
+// this process opened it already, are reported as shared resource quantities
+// (see EstimateSharedTensorResources()) and not as private RAM. Does not open
+// the arena itself.
 Status EstimateResourceFromPathUsingDiskState(const string& path,
                                               FileProbingEnv* env,
                                               ResourceAllocation* estimate);
 
+// Adds to 'estimate' one shared RAM quantity per segment the saved model at
+// 'path' restores into the shared tensor arena, keyed by the segment and
+// charged its full size. The resource tracker charges each key once, however
+// many servables share it. The estimate depends on the model alone, not on
+// which other processes happen to hold the segments. Sets 'shared_file_bytes'
+// to the bytes of those tensors in the variables files.
+Status EstimateSharedTensorResources(const string& path,
+                                     ResourceAllocation* estimate,
+                                     uint64* shared_file_bytes);
+
 // Update metrics for runtime latency.
 void RecordRuntimeLatency(const string& model_name, const string& api,
                           const string& runtime, int64 latency_usec);
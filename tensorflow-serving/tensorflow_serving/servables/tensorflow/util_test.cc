@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
 #include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "tensorflow_serving/servables/tensorflow/bundle_factory_test_util.h"
 #include "tensorflow_serving/test_util/test_util.h"
 #include "tensorflow_serving/util/test_util/mock_file_probing_env.h"
@@ -308,6 +309,37 @@ TEST(ResourceEstimatorTest, EstimateResourceFromPathUsingDiskState) {
   ResourceAllocation expected =
       test_util::GetExpectedResourceEstimate(file_size);
   EXPECT_THAT(actual, EqualsProto(expected));
+  // Estimating does not open the shared tensor arena.
+  EXPECT_EQ(nullptr, SharedTensorArena::GlobalIfOpen());
+}
+
+TEST(ResourceEstimatorTest, EstimateSharedTensorResources) {
+  const string export_dir = io::JoinPath(testing::TmpDir(), "shared_export");
+  const string variables_dir = io::JoinPath(export_dir, "variables");
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(variables_dir));
+  {
+    BundleWriter writer(Env::Default(),
+                        io::JoinPath(variables_dir, "variables"));
+    TF_ASSERT_OK(writer.Add("bias", test::AsTensor<float>({1, 2})));
+    TF_ASSERT_OK(writer.Add("bias_copy", test::AsTensor<float>({1, 2})));
+    TF_ASSERT_OK(writer.Add("names", test::AsTensor<tstring>({"a", "b"})));
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({1, 2, 3, 4})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  ResourceAllocation estimate;
+  uint64 shared_file_bytes = 0;
+  TF_ASSERT_OK(
+      EstimateSharedTensorResources(export_dir, &estimate, &shared_file_bytes));
+  // The string tensor is restored privately, and the identical bias tensors
+  // share one segment which is charged once.
+  EXPECT_EQ(32, shared_file_bytes);
+  ASSERT_EQ(2, estimate.shared_resource_quantities_size());
+  EXPECT_EQ(8, estimate.shared_resource_quantities(0).quantity());
+  EXPECT_EQ(16, estimate.shared_resource_quantities(1).quantity());
+  EXPECT_NE(estimate.shared_resource_quantities(0).key(),
+            estimate.shared_resource_quantities(1).key());
+  EXPECT_EQ(0, estimate.resource_quantities_size());
 }
 
 }  // namespace
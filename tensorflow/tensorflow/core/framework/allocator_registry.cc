@@ -92,17 +92,21 @@ Allocator* AllocatorFactoryRegistry::GetMmapAllocator(std::string mmap_id) {
   mutex_lock l(mu_);
   first_alloc_made_ = true;
   FactoryEntry* best_entry = nullptr;
+  Allocator* best_allocator = nullptr;
   for (auto& entry : factories_) {
-    if(entry.priority == 0) {
-      best_entry = &entry;
+    if (best_entry != nullptr && entry.priority <= best_entry->priority) {
+      continue;
     }
+    Allocator* allocator = entry.factory->CreateMmapAllocator(mmap_id);
+    if (allocator == nullptr) continue;
+    delete best_allocator;
+    best_entry = &entry;
+    best_allocator = allocator;
   }
-  if (best_entry) {
-    return best_entry->factory->CreateMmapAllocator(mmap_id);
-  } else {
-    LOG(FATAL) << "No registered CPU AllocatorFactory";
-    return nullptr;
+  if (best_allocator == nullptr) {
+    LOG(FATAL) << "No registered shared memory AllocatorFactory";
   }
+  return best_allocator;
 }
 
 SubAllocator* AllocatorFactoryRegistry::GetSubAllocator(int numa_node) {
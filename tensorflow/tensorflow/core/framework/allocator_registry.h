@@ -38,7 +38,8 @@ class AllocatorFactory {
   // Create an Allocator.
   virtual Allocator* CreateAllocator() = 0;
 
-  
+  // Create an Allocator placing its allocations in the shared memory segment
+  // named "mmap_id".  Returns nullptr if the factory can not share memory.
   virtual Allocator* CreateMmapAllocator(std::string mmap_id) { return nullptr; }
 
   // Create a SubAllocator. If NumaEnabled() is true, then returned SubAllocator
@@ -74,7 +75,8 @@ class AllocatorFactoryRegistry {
   // been registered with the same priority, picks one by unspecified criteria.
   Allocator* GetAllocator();
 
-  
+  // Returns a new Allocator for the shared memory segment named "mmap_id",
+  // from the highest priority factory that can share memory.
   Allocator* GetMmapAllocator(std::string mmap_id);
 
   // Returns 'best fit' SubAllocator.  First look for the highest priority
@@ -14,8 +14,15 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/platform.h"
+#ifndef IS_MOBILE_PLATFORM
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#endif  // IS_MOBILE_PLATFORM
 
 namespace tensorflow {
 namespace metrics {
@@ -164,6 +171,166 @@ auto* bfc_allocator_delay =
                                 "The total time spent running each graph "
                                 "optimization pass in microseconds.");
 
+auto* shared_tensor_restores = monitoring::Counter<2>::New(
+    "/tensorflow/core/shared_tensor/restores",
+    "The number of tensors restored that could be shared through the shared "
+    "tensor arena, by whether they were attached, filled, mapped from the "
+    "checkpoint or restored into private memory.",
+    "model", "outcome");
+
+auto* shared_tensor_restored_bytes = monitoring::Counter<2>::New(
+    "/tensorflow/core/shared_tensor/restored_bytes",
+    "The bytes of the tensors counted by "
+    "/tensorflow/core/shared_tensor/restores.",
+    "model", "outcome");
+
+auto* shared_tensor_attach_usecs = monitoring::Sampler<0>::New(
+    {"/tensorflow/core/shared_tensor/attach_usecs",
+     "Microseconds spent attaching to a shared tensor restored by another "
+     "process, including waiting for it to be filled."},
+    // 10 microseconds to about 10 minutes.
+    {monitoring::Buckets::Exponential(10, 4, 14)});
+
+#ifndef IS_MOBILE_PLATFORM
+
+// The state of the shared tensor arena of this process, collected when the
+// metrics are exported.  Nothing is collected until the arena is opened.
+// The arena is node-wide: every process attached to it reports the same
+// values under the same "arena" label, to be aggregated with max, not sum.
+const monitoring::MetricDef<monitoring::MetricKind::kGauge, int64, 2>
+    shared_tensor_arena_bytes(
+        "/tensorflow/core/shared_tensor_arena/bytes",
+        "Bytes of the shared tensor arena of the node, by kind: allocated to "
+        "segments, of them on huge pages, saved by sharing them, free, and in "
+        "the largest free extent. The same in every process of the node.",
+        "arena", "kind");
+
+const monitoring::MetricDef<monitoring::MetricKind::kGauge, int64, 1>
+    shared_tensor_arena_segments(
+        "/tensorflow/core/shared_tensor_arena/segments",
+        "The number of segments in the shared tensor arena of the node. The "
+        "same in every process of the node.",
+        "arena");
+
+const monitoring::MetricDef<monitoring::MetricKind::kCumulative, int64, 1>
+    shared_tensor_arena_reclaimed_bytes(
+        "/tensorflow/core/shared_tensor_arena/reclaimed_bytes",
+        "Bytes of the segments reclaimed or evicted from the shared tensor "
+        "arena of the node. The same in every process of the node.",
+        "arena");
+
+const monitoring::MetricDef<monitoring::MetricKind::kCumulative, int64, 1>
+    shared_tensor_arena_evictions(
+        "/tensorflow/core/shared_tensor_arena/evictions",
+        "The number of segments evicted from the shared tensor arena of the "
+        "node before the end of their grace period to make room. The same in "
+        "every process of the node.",
+        "arena");
+
+const monitoring::MetricDef<monitoring::MetricKind::kCumulative, int64, 0>
+    shared_tensor_fallbacks(
+        "/tensorflow/core/shared_tensor/fallbacks",
+        "The number of tensors placed in private memory because they could not "
+        "be shared.");
+
+// GetStats() scans the whole index under the node-wide mutex of the arena, so
+// the arena metrics of one export are read from a single snapshot of the
+// stats, taken by the first of them to be collected.  The registry collects
+// the metrics one after the other, well within the age of a snapshot.
+constexpr uint64 kArenaStatsSnapshotMicros = 1000 * 1000;
+
+struct ArenaStatsSnapshot {
+  mutex mu;
+  uint64 taken_micros TF_GUARDED_BY(mu) = 0;
+  SharedTensorArena::Stats stats TF_GUARDED_BY(mu);
+};
+
+// Sets "*stats" to a recent snapshot of the stats of "arena".
+void GetArenaStats(SharedTensorArena* arena, SharedTensorArena::Stats* stats) {
+  static ArenaStatsSnapshot* snapshot = new ArenaStatsSnapshot;
+  mutex_lock l(snapshot->mu);
+  const uint64 now_micros = EnvTime::NowMicros();
+  if (snapshot->taken_micros == 0 ||
+      now_micros - snapshot->taken_micros >= kArenaStatsSnapshotMicros) {
+    snapshot->stats = arena->GetStats();
+    snapshot->taken_micros = now_micros;
+  }
+  *stats = snapshot->stats;
+}
+
+template <monitoring::MetricKind kind, int NumLabels>
+void RegisterArenaMetric(
+    const monitoring::MetricDef<kind, int64, NumLabels>* metric_def,
+    std::function<void(const string&, const SharedTensorArena::Stats&,
+                       monitoring::MetricCollector<kind, int64, NumLabels>*)>
+        collect) {
+  // Never unregistered, like the metric definitions.
+  auto collection = [metric_def,
+                     collect](monitoring::MetricCollectorGetter getter) {
+    SharedTensorArena* arena = SharedTensorArena::GlobalIfOpen();
+    if (arena == nullptr) return;
+    SharedTensorArena::Stats stats;
+    GetArenaStats(arena, &stats);
+    auto collector = getter.Get(metric_def);
+    collect(arena->path(), stats, &collector);
+  };
+  monitoring::CollectionRegistry::Default()
+      ->Register(metric_def, collection)
+      .release();
+}
+
+const bool shared_tensor_arena_metrics_registered = [] {
+  using Gauge2 = monitoring::MetricCollector<monitoring::MetricKind::kGauge,
+                                             int64, 2>;
+  using Gauge1 = monitoring::MetricCollector<monitoring::MetricKind::kGauge,
+                                             int64, 1>;
+  using Cumulative1 =
+      monitoring::MetricCollector<monitoring::MetricKind::kCumulative, int64,
+                                  1>;
+  RegisterArenaMetric<monitoring::MetricKind::kGauge, 2>(
+      &shared_tensor_arena_bytes,
+      [](const string& arena, const SharedTensorArena::Stats& stats,
+         Gauge2* collector) {
+        int64 saved_bytes = 0;
+        for (const auto& node : stats.nodes) saved_bytes += node.saved_bytes;
+        collector->CollectValue({arena, "allocated"}, stats.allocated_bytes);
+        collector->CollectValue({arena, "huge_page"}, stats.huge_page_bytes);
+        collector->CollectValue({arena, "saved"}, saved_bytes);
+        collector->CollectValue({arena, "free"}, stats.free_bytes);
+        collector->CollectValue({arena, "largest_free_extent"},
+                                stats.largest_free_extent_bytes);
+      });
+  RegisterArenaMetric<monitoring::MetricKind::kGauge, 1>(
+      &shared_tensor_arena_segments,
+      [](const string& arena, const SharedTensorArena::Stats& stats,
+         Gauge1* collector) {
+        collector->CollectValue({arena}, stats.num_segments);
+      });
+  RegisterArenaMetric<monitoring::MetricKind::kCumulative, 1>(
+      &shared_tensor_arena_reclaimed_bytes,
+      [](const string& arena, const SharedTensorArena::Stats& stats,
+         Cumulative1* collector) {
+        collector->CollectValue({arena}, stats.reclaimed_bytes);
+      });
+  RegisterArenaMetric<monitoring::MetricKind::kCumulative, 1>(
+      &shared_tensor_arena_evictions,
+      [](const string& arena, const SharedTensorArena::Stats& stats,
+         Cumulative1* collector) {
+        collector->CollectValue({arena}, stats.num_evictions);
+      });
+  // Counted by this process whether or not it has an arena.
+  monitoring::CollectionRegistry::Default()
+      ->Register(&shared_tensor_fallbacks,
+                 [](monitoring::MetricCollectorGetter getter) {
+                   getter.Get(&shared_tensor_fallbacks)
+                       .CollectValue({}, SharedTensorArena::NumFallbacks());
+                 })
+      .release();
+  return true;
+}();
+
+#endif  // IS_MOBILE_PLATFORM
+
 }  // namespace
 
 void RecordTFDataAutotune(const string& name) {
@@ -317,5 +484,18 @@ void RecordUnusedOutput(const string& op_name) {
   graph_unused_outputs->GetCell(op_name)->IncrementBy(1);
 }
 
+void RecordSharedTensorRestore(const string& model, const string& outcome,
+                               int64 num_bytes) {
+  shared_tensor_restores->GetCell(model, outcome)->IncrementBy(1);
+  shared_tensor_restored_bytes->GetCell(model, outcome)
+      ->IncrementBy(num_bytes);
+}
+
+void RecordSharedTensorAttachTime(uint64 duration_us) {
+  static auto* shared_tensor_attach_usecs_cell =
+      shared_tensor_attach_usecs->GetCell();
+  shared_tensor_attach_usecs_cell->Add(duration_us);
+}
+
 }  // namespace metrics
 }  // namespace tensorflow
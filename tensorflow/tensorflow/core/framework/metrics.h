@@ -130,6 +130,21 @@ void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs);
 // Increment the number of jobs that failed during import to mlir.
 void IncrementMLIRImportFailureCount();
 
+// Records the restore of a tensor of `num_bytes` bytes that could be shared
+// with other processes through the shared tensor arena.
+//
+// The `model` argument identifies the model restoring it, and `outcome` is
+// "attached" if another process had already restored it, "filled" if this
+// process restored it into the arena, "mapped" if it was mapped from the
+// checkpoint data file instead, or "private" if it had to be restored into
+// private memory.
+void RecordSharedTensorRestore(const string& model, const string& outcome,
+                               int64 num_bytes);
+
+// Records the time spent attaching to a tensor restored by another process,
+// including waiting for that process to finish filling it.
+void RecordSharedTensorAttachTime(uint64 duration_us);
+
 }  // namespace metrics
 }  // namespace tensorflow
 
@@ -0,0 +1,81 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/metrics.h"
+
+#include <map>
+
+#include "tensorflow/core/framework/shared_tensor_arena.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/collected_metrics.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace metrics {
+namespace {
+
+// Returns the points of the metric "name" by their labels, joined with ",".
+std::map<string, int64> CollectPoints(const string& name) {
+  std::map<string, int64> points;
+  const std::unique_ptr<monitoring::CollectedMetrics> collected =
+      monitoring::CollectionRegistry::Default()->CollectMetrics({});
+  const auto it = collected->point_set_map.find(name);
+  if (it == collected->point_set_map.end()) return points;
+  for (const auto& point : it->second->points) {
+    string labels;
+    for (const auto& label : point->labels) {
+      if (!labels.empty()) labels += ",";
+      labels += label.value;
+    }
+    points[labels] = point->int64_value;
+  }
+  return points;
+}
+
+TEST(MetricsTest, SharedTensorArenaMetricsAreLabeledWithTheArena) {
+  EXPECT_TRUE(
+      CollectPoints("/tensorflow/core/shared_tensor_arena/segments").empty());
+
+  SharedTensorArena::Options options;
+  options.path = io::JoinPath(testing::TmpDir(), "metrics_arena");
+  options.capacity_bytes = 1 << 20;
+  options.index_capacity = 16;
+  Env::Default()->DeleteFile(options.path).IgnoreError();
+  TF_ASSERT_OK(SharedTensorArena::ConfigureGlobal(options, ""));
+  SharedTensorArena* arena = SharedTensorArena::Global();
+  ASSERT_NE(nullptr, arena);
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  arena->FinishFill("weights", data, Status::OK());
+
+  const std::map<string, int64> segments =
+      CollectPoints("/tensorflow/core/shared_tensor_arena/segments");
+  ASSERT_EQ(1, segments.size());
+  EXPECT_EQ(1, segments.at(options.path));
+  const std::map<string, int64> bytes =
+      CollectPoints("/tensorflow/core/shared_tensor_arena/bytes");
+  EXPECT_EQ(4096, bytes.at(options.path + ",allocated"));
+  EXPECT_EQ(1, bytes.count(options.path + ",free"));
+  EXPECT_EQ(0, CollectPoints("/tensorflow/core/shared_tensor_arena/evictions")
+                   .at(options.path));
+}
+
+}  // namespace
+}  // namespace metrics
+}  // namespace tensorflow
@@ -0,0 +1,1380 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/shared_tensor_arena.h"
+
+#include "tensorflow/core/platform/platform.h"
+
+// The arena is built on Linux only: futexes, open file description locks,
+// mbind() and hole punching have no portable equivalent.  Elsewhere it can not
+// be opened, and every tensor stays in private memory.
+#if defined(__linux__) && !defined(IS_MOBILE_PLATFORM)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/error.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/hash.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/str_util.h"
+
+namespace tensorflow {
+
+namespace {
+
+const uint64 kArenaMagic = 0x414e455241535454ULL;  // "TTSARENA"
+const uint32 kArenaVersion = 7;
+
+// Segments are page aligned, so that their pages are never shared with another
+// segment.
+const uint64 kPageBytes = 4096;
+const uint64 kHugePageBytes = 2 << 20;
+
+const size_t kMaxKeyBytes = 64;
+
+// Maximum number of arena objects open at once on a node.  Process slot "i" is
+// held by a write lock on byte "i" of the arena file.
+const int kMaxProcesses = 256;
+const int kHolderWords = kMaxProcesses / 64;
+
+const int kMaxNumaNodes = 64;
+
+// States of an index slot.
+enum SegmentState : uint32 {
+  // The slot never held a segment.  Ends a probe sequence.
+  kSegmentEmpty = 0,
+  kSegmentFilling = 1,
+  kSegmentReady = 2,
+  // The last fill failed.
+  kSegmentFailed = 3,
+  // The segment of the slot was reclaimed.  Probing continues past it.
+  kSegmentDeleted = 4,
+};
+
+// Waiters wake up at least this often to check whether the owner of the fill
+// died, since that does not wake them up.
+const int64 kOwnerPollMicros = 100 * 1000;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "futex requires lock-free atomics");
+
+// Blocks until "*word" is woken up or no longer holds "expected", or
+// "timeout_micros" elapsed.  The word is in a shared mapping, so the futex
+// can not be process private.
+void FutexWait(std::atomic<uint32>* word, uint32 expected,
+               int64 timeout_micros) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_micros / 1000000;
+  timeout.tv_nsec = (timeout_micros % 1000000) * 1000;
+  syscall(SYS_futex, reinterpret_cast<uint32*>(word), FUTEX_WAIT, expected,
+          &timeout, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<uint32>* word) {
+  syscall(SYS_futex, reinterpret_cast<uint32*>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+// Sets "*lock" to a lock of type "type" on process slot "slot".
+void InitProcessLock(int slot, int type, struct flock* lock) {
+  memset(lock, 0, sizeof(*lock));
+  lock->l_type = type;
+  lock->l_whence = SEEK_SET;
+  lock->l_start = slot;
+  lock->l_len = 1;
+}
+
+uint64 RoundUp(uint64 n, uint64 multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// Maps "size" bytes of "fd" shared, at an address aligned to a huge page so
+// that segments aligned to huge pages in the file are in memory too.
+void* MapAligned(int fd, uint64 size) {
+  char* reserved = static_cast<char*>(
+      mmap(nullptr, size + kHugePageBytes, PROT_NONE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+  if (reserved == MAP_FAILED) return MAP_FAILED;
+  char* aligned = reinterpret_cast<char*>(
+      RoundUp(reinterpret_cast<uintptr_t>(reserved), kHugePageBytes));
+  void* base = mmap(aligned, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_NORESERVE | MAP_FIXED, fd, 0);
+  if (base == MAP_FAILED) {
+    munmap(reserved, size + kHugePageBytes);
+    return MAP_FAILED;
+  }
+  if (aligned > reserved) munmap(reserved, aligned - reserved);
+  munmap(aligned + size, reserved + kHugePageBytes - aligned);
+  return base;
+}
+
+// Returns the NUMA node holding most of the CPUs this process may run on, or
+// -1 if the machine has a single node or it can not be told.
+int LocalNumaNode() {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) return -1;
+  int num_nodes = 0;
+  int local_node = -1;
+  int local_cpus = 0;
+  for (int node = 0; node < kMaxNumaNodes; ++node) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) continue;
+    char line[4096];
+    const bool read = fgets(line, sizeof(line), file) != nullptr;
+    fclose(file);
+    if (!read) continue;
+    ++num_nodes;
+    // Ranges of CPUs, e.g. "0-3,8-11".
+    int node_cpus = 0;
+    char* p = line;
+    while (true) {
+      char* end;
+      const long first = strtol(p, &end, 10);
+      if (end == p) break;
+      long last = first;
+      if (*end == '-') {
+        p = end + 1;
+        last = strtol(p, &end, 10);
+      }
+      for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpus)) ++node_cpus;
+      }
+      if (*end != ',') break;
+      p = end + 1;
+    }
+    if (node_cpus > local_cpus) {
+      local_node = node;
+      local_cpus = node_cpus;
+    }
+  }
+  return num_nodes > 1 ? local_node : -1;
+}
+
+// Makes the pages of [addr, addr + num_bytes) allocated from now on prefer
+// NUMA node "node".  For a shared mapping, the policy belongs to the file.
+void PreferNumaNode(void* addr, uint64 num_bytes, int node) {
+  unsigned long mask[kMaxNumaNodes / (8 * sizeof(unsigned long))] = {};
+  mask[node / (8 * sizeof(unsigned long))] =
+      1UL << (node % (8 * sizeof(unsigned long)));
+  if (syscall(SYS_mbind, addr, num_bytes, MPOL_PREFERRED, mask,
+              kMaxNumaNodes + 1, 0) != 0) {
+    VLOG(1) << "Failed to place " << num_bytes << " bytes on NUMA node "
+            << node << ": " << strerror(errno);
+  }
+}
+
+bool ParseHugePages(StringPiece value, SharedTensorArena::HugePages* pages) {
+  if (value == "none") {
+    *pages = SharedTensorArena::HugePages::kNone;
+  } else if (value == "transparent") {
+    *pages = SharedTensorArena::HugePages::kTransparent;
+  } else if (value == "hugetlbfs") {
+    *pages = SharedTensorArena::HugePages::kHugetlbfs;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Counted by RecordFallback().
+std::atomic<int64> num_fallbacks{0};
+
+// Set once Global() opened the arena.
+std::atomic<SharedTensorArena*> global_arena{nullptr};
+
+// How Global() opens the arena, as set with ConfigureGlobal().
+struct GlobalConfig {
+  mutex mu;
+  bool opened TF_GUARDED_BY(mu) = false;
+  bool configured TF_GUARDED_BY(mu) = false;
+  SharedTensorArena::Options options TF_GUARDED_BY(mu);
+  string socket_path TF_GUARDED_BY(mu);
+};
+
+GlobalConfig* GetGlobalConfig() {
+  static GlobalConfig* config = new GlobalConfig;
+  return config;
+}
+
+// Requests of the node daemon protocol, one line per connection.  The answer
+// to "attach" is the arena file descriptor, to "stats" the arena statistics
+// in the Prometheus text format.
+const char kAttachRequest[] = "attach";
+const char kStatsRequest[] = "stats";
+const size_t kMaxRequestBytes = 64;
+
+Status WriteAll(int socket, StringPiece data) {
+  while (!data.empty()) {
+    const ssize_t n = send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return IOError("Failed to write to the shared tensor arena socket",
+                     errno);
+    }
+    data.remove_prefix(n);
+  }
+  return Status::OK();
+}
+
+Status ReadLine(int socket, string* line) {
+  line->clear();
+  while (line->size() < kMaxRequestBytes) {
+    char c;
+    const ssize_t n = recv(socket, &c, 1, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      return IOError("Failed to read from the shared tensor arena socket",
+                     errno);
+    }
+    if (n == 0 || c == '\n') return Status::OK();
+    line->push_back(c);
+  }
+  return errors::InvalidArgument("Shared tensor arena request too long");
+}
+
+Status SendFd(int socket, int fd) {
+  char byte = 0;
+  struct iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  while (sendmsg(socket, &msg, MSG_NOSIGNAL) < 0) {
+    if (errno != EINTR) {
+      return IOError("Failed to send the shared tensor arena", errno);
+    }
+  }
+  return Status::OK();
+}
+
+Status ReceiveFd(int socket, int* fd) {
+  char byte;
+  struct iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  while ((n = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+    if (errno != EINTR) {
+      return IOError("Failed to receive the shared tensor arena", errno);
+    }
+  }
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (n == 0 || cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS) {
+    return errors::Unavailable(
+        "The shared tensor arena daemon did not send the arena");
+  }
+  memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+  return Status::OK();
+}
+
+// Closes a file descriptor unless released.
+class ScopedFd {
+ public:
+  explicit ScopedFd(int fd) : fd_(fd) {}
+  ~ScopedFd() {
+    if (fd_ >= 0) close(fd_);
+  }
+  int get() const { return fd_; }
+  int release() {
+    int fd = fd_;
+    fd_ = -1;
+    return fd;
+  }
+
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+// Lives at the start of the arena file.
+struct SharedTensorArena::Header {
+  // Written last when the arena is initialized.
+  std::atomic<uint64> magic;
+  uint32 version;
+  uint32 index_capacity;
+  uint64 capacity_bytes;
+  // A HugePages.
+  uint32 huge_pages;
+  // Offsets of the index, the free list and the data region from the start of
+  // the file.
+  uint64 index_offset;
+  uint64 free_list_offset;
+  uint64 data_offset;
+
+  // Robust and process-shared.  Guards the index and the fields below.
+  pthread_mutex_t mutex;
+  // Length of the free list, sorted by offset and holding no adjacent
+  // extents.
+  uint64 num_free_extents;
+  uint64 allocated_bytes;
+  uint64 num_segments;
+  uint64 huge_page_bytes;
+  uint64 num_evictions;
+  uint64 reclaimed_bytes;
+  // Bumped every time a process slot is claimed, so that a fill owned by a
+  // dead process is not mistaken for one owned by the next holder of its slot.
+  uint64 process_generation[kMaxProcesses];
+};
+
+// One slot of the open-addressing hash index.
+struct SharedTensorArena::IndexEntry {
+  // Null-terminated.  Empty iff the slot holds no segment.
+  char key[kMaxKeyBytes];
+  // Offset of the segment from the start of the file.
+  uint64 offset;
+  uint64 num_bytes;
+  // A SegmentState.  Written under the arena lock, waited on without it.
+  std::atomic<uint32> state;
+  // Process slot and generation of the owner of the fill, if FILLING.
+  uint32 owner_slot;
+  uint64 owner_generation;
+  // Bit "i" is set iff the process in slot "i" holds the segment.
+  uint64 holders[kHolderWords];
+  // When the last holder released the segment.
+  uint64 released_micros;
+  // NUMA node the pages of the segment were placed on.
+  int32 numa_node;
+  uint32 unused;
+  uint64 reserved[6];
+
+  bool IsHeld() const {
+    for (int i = 0; i < kHolderWords; ++i) {
+      if (holders[i] != 0) return true;
+    }
+    return false;
+  }
+  int NumHolders() const {
+    int n = 0;
+    for (int i = 0; i < kHolderWords; ++i) {
+      n += __builtin_popcountll(holders[i]);
+    }
+    return n;
+  }
+  bool HasHolder(int slot) const {
+    return holders[slot / 64] & (1ULL << (slot % 64));
+  }
+  void SetHolder(int slot) { holders[slot / 64] |= 1ULL << (slot % 64); }
+  void ClearHolder(int slot) { holders[slot / 64] &= ~(1ULL << (slot % 64)); }
+};
+
+// A range of the data region not handed out to any segment.
+struct SharedTensorArena::Extent {
+  uint64 offset;
+  uint64 num_bytes;
+};
+
+// Holds the arena mutex, recovering it if its previous owner died.
+class SharedTensorArena::ScopedLock {
+ public:
+  explicit ScopedLock(pthread_mutex_t* mu) : mu_(mu) {
+    int rc = pthread_mutex_lock(mu_);
+    if (rc == EOWNERDEAD) {
+      LOG(WARNING) << "A process died holding the shared tensor arena lock";
+      rc = pthread_mutex_consistent(mu_);
+    }
+    CHECK_EQ(rc, 0) << "Failed to lock the shared tensor arena: "
+                    << strerror(rc);
+  }
+  ~ScopedLock() { pthread_mutex_unlock(mu_); }
+
+ private:
+  pthread_mutex_t* const mu_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedLock);
+};
+
+Status SharedTensorArena::Open(const Options& options,
+                               std::unique_ptr<SharedTensorArena>* arena) {
+  ScopedFd fd(open(options.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                   S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH));
+  if (fd.get() < 0) {
+    return IOError("Failed to open " + options.path, errno);
+  }
+  return OpenFile(options, fd.release(), arena);
+}
+
+Status SharedTensorArena::OpenFile(const Options& options, int file,
+                                   std::unique_ptr<SharedTensorArena>* arena) {
+  ScopedFd fd(file);
+  // The first process to take the file lock initializes the arena, the others
+  // wait for it here.
+  if (flock(fd.get(), LOCK_EX) != 0) {
+    return IOError("Failed to lock " + options.path, errno);
+  }
+  struct stat statbuf;
+  if (fstat(fd.get(), &statbuf) != 0) {
+    return IOError("Failed to stat " + options.path, errno);
+  }
+
+  uint64 mapped_size = statbuf.st_size;
+  const bool initialize = mapped_size == 0;
+  // Everything in a hugetlbfs file is made of huge pages, and only the data
+  // region needs to be aligned to them otherwise.
+  const uint64 page_bytes = options.huge_pages == HugePages::kHugetlbfs
+                                ? kHugePageBytes
+                                : kPageBytes;
+  const uint64 data_alignment =
+      options.huge_pages == HugePages::kNone ? kPageBytes : kHugePageBytes;
+  // Free extents are separated by segments, so there is at most one more
+  // of them than segments.
+  const uint64 index_bytes = RoundUp(
+      static_cast<uint64>(options.index_capacity) * sizeof(IndexEntry),
+      page_bytes);
+  const uint64 free_list_bytes = RoundUp(
+      (static_cast<uint64>(options.index_capacity) + 1) * sizeof(Extent),
+      page_bytes);
+  const uint64 data_offset =
+      RoundUp(page_bytes + index_bytes + free_list_bytes, data_alignment);
+  if (initialize) {
+    // The mode open() created the file with is masked by the umask.
+    if (fchmod(fd.get(), options.file_mode) != 0) {
+      return IOError("Failed to set the mode of " + options.path, errno);
+    }
+    mapped_size =
+        data_offset + RoundUp(options.capacity_bytes, data_alignment);
+    if (ftruncate(fd.get(), mapped_size) != 0) {
+      return IOError("Failed to size " + options.path, errno);
+    }
+  } else if (mapped_size < kPageBytes) {
+    return errors::DataLoss("Shared tensor arena ", options.path,
+                            " is truncated");
+  }
+
+  void* base = MapAligned(fd.get(), mapped_size);
+  if (base == MAP_FAILED) {
+    return IOError("Failed to map " + options.path, errno);
+  }
+  arena->reset(new SharedTensorArena(options, fd.release(),
+                                     static_cast<char*>(base), mapped_size));
+  Header* header = (*arena)->header();
+
+  if (initialize) {
+    header->version = kArenaVersion;
+    header->index_capacity = options.index_capacity;
+    header->huge_pages = static_cast<uint32>(options.huge_pages);
+    header->index_offset = page_bytes;
+    header->free_list_offset = page_bytes + index_bytes;
+    header->data_offset = data_offset;
+    header->capacity_bytes = mapped_size - header->data_offset;
+    header->num_free_extents = 1;
+    (*arena)->free_extents()[0] = {header->data_offset,
+                                   header->capacity_bytes};
+    header->allocated_bytes = 0;
+    header->num_segments = 0;
+    header->huge_page_bytes = 0;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    header->magic.store(kArenaMagic, std::memory_order_release);
+  }
+  flock((*arena)->fd_, LOCK_UN);
+
+  if (header->magic.load(std::memory_order_acquire) != kArenaMagic ||
+      header->version != kArenaVersion) {
+    arena->reset();
+    return errors::FailedPrecondition(
+        "Shared tensor arena ", options.path,
+        " was created by an incompatible version, remove it to recreate it");
+  }
+  if (header->data_offset + header->capacity_bytes != mapped_size) {
+    arena->reset();
+    return errors::DataLoss("Shared tensor arena ", options.path,
+                            " does not match its header");
+  }
+  (*arena)->huge_pages_ = static_cast<HugePages>(header->huge_pages);
+  if (options.huge_pages != HugePages::kNone &&
+      (*arena)->huge_pages_ != options.huge_pages) {
+    LOG(WARNING) << "Shared tensor arena " << options.path
+                 << " was created with other huge pages, using them";
+  }
+  if ((*arena)->huge_pages_ == HugePages::kTransparent &&
+      madvise((*arena)->base_ + header->data_offset, header->capacity_bytes,
+              MADV_HUGEPAGE) != 0) {
+    LOG(WARNING) << "Failed to advise huge pages for " << options.path << ": "
+                 << strerror(errno);
+  }
+  Status s = (*arena)->ClaimProcessSlot();
+  if (!s.ok()) arena->reset();
+  return s;
+}
+
+Status SharedTensorArena::Connect(const string& socket_path,
+                                  const Options& options,
+                                  std::unique_ptr<SharedTensorArena>* arena) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    return errors::InvalidArgument("Socket path too long: ", socket_path);
+  }
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  ScopedFd sock(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (sock.get() < 0) {
+    return IOError("Failed to create a socket", errno);
+  }
+  if (connect(sock.get(), reinterpret_cast<struct sockaddr*>(&addr),
+              sizeof(addr)) != 0) {
+    return IOError("Failed to connect to " + socket_path, errno);
+  }
+  TF_RETURN_IF_ERROR(WriteAll(sock.get(), absl::StrCat(kAttachRequest, "\n")));
+  int received;
+  TF_RETURN_IF_ERROR(ReceiveFd(sock.get(), &received));
+  ScopedFd daemon_fd(received);
+
+  // The descriptor received shares its open file description, and hence its
+  // process slot locks, with the daemon.  Open the file anew.
+  char proc_path[64];
+  snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", received);
+  ScopedFd fd(open(proc_path, O_RDWR | O_CLOEXEC));
+  if (fd.get() < 0) {
+    return IOError("Failed to open the arena of " + socket_path, errno);
+  }
+  Options arena_options = options;
+  char path[PATH_MAX];
+  const ssize_t n = readlink(proc_path, path, sizeof(path));
+  arena_options.path =
+      n > 0 && static_cast<size_t>(n) < sizeof(path) ? string(path, n)
+                                                     : socket_path;
+  return OpenFile(arena_options, fd.release(), arena);
+}
+
+Status SharedTensorArena::Serve(int connection) {
+  string request;
+  TF_RETURN_IF_ERROR(ReadLine(connection, &request));
+  if (request == kAttachRequest) {
+    return SendFd(connection, fd_);
+  }
+  if (request == kStatsRequest) {
+    const Stats stats = GetStats();
+    string text = absl::StrCat(
+        "shared_tensor_arena_capacity_bytes ", stats.capacity_bytes, "\n",
+        "shared_tensor_arena_allocated_bytes ", stats.allocated_bytes, "\n",
+        "shared_tensor_arena_segments ", stats.num_segments, "\n",
+        "shared_tensor_arena_huge_page_bytes ", stats.huge_page_bytes, "\n",
+        "shared_tensor_arena_evictions_total ", stats.num_evictions, "\n",
+        "shared_tensor_arena_reclaimed_bytes_total ", stats.reclaimed_bytes,
+        "\n", "shared_tensor_arena_free_bytes ", stats.free_bytes, "\n",
+        "shared_tensor_arena_largest_free_extent_bytes ",
+        stats.largest_free_extent_bytes, "\n");
+    for (size_t node = 0; node < stats.nodes.size(); ++node) {
+      absl::StrAppend(&text, "shared_tensor_arena_node_allocated_bytes{node=\"",
+                      node, "\"} ", stats.nodes[node].allocated_bytes, "\n",
+                      "shared_tensor_arena_node_saved_bytes{node=\"", node,
+                      "\"} ", stats.nodes[node].saved_bytes, "\n");
+    }
+    return WriteAll(connection, text);
+  }
+  return errors::InvalidArgument("Unknown shared tensor arena request: ",
+                                 request);
+}
+
+SharedTensorArena* SharedTensorArena::Global() {
+  static SharedTensorArena* arena = []() -> SharedTensorArena* {
+    Options options;
+    string socket_path;
+    bool configured;
+    GlobalConfig* config = GetGlobalConfig();
+    {
+      mutex_lock l(config->mu);
+      config->opened = true;
+      configured = config->configured;
+      if (configured) {
+        options = config->options;
+        socket_path = config->socket_path;
+      }
+    }
+    if (!configured) GlobalOptionsFromEnv(&options, &socket_path);
+    std::unique_ptr<SharedTensorArena> arena;
+    Status s = !socket_path.empty() ? Connect(socket_path, options, &arena)
+                                    : Open(options, &arena);
+    if (!s.ok()) {
+      LOG(WARNING) << "Tensors will not be shared: " << s;
+      return nullptr;
+    }
+    SharedTensorArena* global = arena.release();
+    const int64 interval_micros =
+        std::max<int64>(options.reclaim_grace_micros / 2, 1000 * 1000);
+    // Never joined, like the arena it works on.
+    Env::Default()->StartThread(
+        ThreadOptions(), "shared_tensor_reclaimer", [global, interval_micros] {
+          while (true) {
+            Env::Default()->SleepForMicroseconds(interval_micros);
+            global->Reclaim();
+          }
+        });
+    global_arena.store(global, std::memory_order_release);
+    return global;
+  }();
+  return arena;
+}
+
+void SharedTensorArena::GlobalOptionsFromEnv(Options* options,
+                                             string* socket_path) {
+  if (const char* path = getenv("TF_SHARED_TENSOR_ARENA_PATH")) {
+    options->path = path;
+  }
+  if (const char* pages = getenv("TF_SHARED_TENSOR_HUGE_PAGES")) {
+    if (!ParseHugePages(pages, &options->huge_pages)) {
+      LOG(ERROR) << "Invalid TF_SHARED_TENSOR_HUGE_PAGES: " << pages;
+    }
+  }
+  if (const char* replicas = getenv("TF_SHARED_TENSOR_NUMA_REPLICAS")) {
+    options->numa_replicas =
+        strcmp(replicas, "true") == 0 || strcmp(replicas, "1") == 0;
+  }
+  if (const char* socket = getenv("TF_SHARED_TENSOR_ARENA_SOCKET")) {
+    *socket_path = socket;
+  }
+}
+
+void SharedTensorArena::RecordFallback() {
+  num_fallbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64 SharedTensorArena::NumFallbacks() {
+  return num_fallbacks.load(std::memory_order_relaxed);
+}
+
+SharedTensorArena* SharedTensorArena::GlobalIfOpen() {
+  return global_arena.load(std::memory_order_acquire);
+}
+
+Status SharedTensorArena::ConfigureGlobal(const Options& options,
+                                          const string& socket_path) {
+  GlobalConfig* config = GetGlobalConfig();
+  mutex_lock l(config->mu);
+  if (config->opened) {
+    return errors::FailedPrecondition(
+        "The shared tensor arena of this process is already open");
+  }
+  config->configured = true;
+  config->options = options;
+  config->socket_path = socket_path;
+  return Status::OK();
+}
+
+SharedTensorArena::SharedTensorArena(const Options& options, int fd,
+                                     char* base, uint64 mapped_size)
+    : path_(options.path),
+      wait_timeout_micros_(options.wait_timeout_micros),
+      reclaim_grace_micros_(options.reclaim_grace_micros),
+      numa_node_(options.numa_node >= 0 && options.numa_node < kMaxNumaNodes
+                     ? options.numa_node
+                     : LocalNumaNode()),
+      numa_replicas_(options.numa_replicas && numa_node_ >= 0),
+      fd_(fd),
+      base_(base),
+      mapped_size_(mapped_size) {}
+
+SharedTensorArena::~SharedTensorArena() {
+  munmap(base_, mapped_size_);
+  close(fd_);
+}
+
+SharedTensorArena::Header* SharedTensorArena::header() const {
+  static_assert(sizeof(Header) <= kPageBytes,
+                "the arena header must fit in a page");
+  return reinterpret_cast<Header*>(base_);
+}
+
+SharedTensorArena::IndexEntry* SharedTensorArena::index() const {
+  return reinterpret_cast<IndexEntry*>(base_ + header()->index_offset);
+}
+
+SharedTensorArena::Extent* SharedTensorArena::free_extents() const {
+  return reinterpret_cast<Extent*>(base_ + header()->free_list_offset);
+}
+
+Status SharedTensorArena::ClaimProcessSlot() {
+  // The lock belongs to the open file description, so it is released when the
+  // arena is closed or the process dies, and is not shared with other arena
+  // objects of the same process.
+  for (int slot = 0; slot < kMaxProcesses; ++slot) {
+    struct flock lock;
+    InitProcessLock(slot, F_WRLCK, &lock);
+    if (fcntl(fd_, F_OFD_SETLK, &lock) != 0) {
+      if (errno == EAGAIN || errno == EACCES) continue;
+      return IOError("Failed to lock a process slot of " + path_, errno);
+    }
+    ScopedLock l(&header()->mutex);
+    process_slot_ = slot;
+    process_generation_ = ++header()->process_generation[slot];
+    // Whoever held the slot before is gone.
+    DropHolds(slot, EnvTime::NowMicros());
+    return Status::OK();
+  }
+  return errors::ResourceExhausted("Shared tensor arena ", path_, " has no ",
+                                   "free process slot");
+}
+
+SharedTensorArena::IndexEntry* SharedTensorArena::FindSlot(StringPiece key) {
+  const uint32 capacity = header()->index_capacity;
+  IndexEntry* entries = index();
+  IndexEntry* deleted = nullptr;
+  uint32 slot = Hash64(key.data(), key.size()) % capacity;
+  for (uint32 probe = 0; probe < capacity; ++probe) {
+    IndexEntry* entry = &entries[slot];
+    if (entry->key[0] == '\0') {
+      if (entry->state.load(std::memory_order_relaxed) != kSegmentDeleted) {
+        return deleted != nullptr ? deleted : entry;
+      }
+      if (deleted == nullptr) deleted = entry;
+    } else if (strncmp(entry->key, key.data(), kMaxKeyBytes) == 0) {
+      return entry;
+    }
+    slot = (slot + 1) % capacity;
+  }
+  return deleted;
+}
+
+uint64 SharedTensorArena::SegmentAlignment(uint64 num_bytes) const {
+  switch (huge_pages_) {
+    case HugePages::kHugetlbfs:
+      return kHugePageBytes;
+    case HugePages::kTransparent:
+      return num_bytes >= kHugePageBytes ? kHugePageBytes : kPageBytes;
+    default:
+      return kPageBytes;
+  }
+}
+
+uint64 SharedTensorArena::SegmentBytes(uint64 num_bytes) const {
+  return RoundUp(std::max<uint64>(num_bytes, 1), SegmentAlignment(num_bytes));
+}
+
+bool SharedTensorArena::AllocateExtent(uint64 num_bytes, uint64 alignment,
+                                       uint64* offset) {
+  Header* h = header();
+  Extent* extents = free_extents();
+  for (uint64 i = 0; i < h->num_free_extents; ++i) {
+    Extent* extent = &extents[i];
+    const uint64 start = RoundUp(extent->offset, alignment);
+    const uint64 end = extent->offset + extent->num_bytes;
+    if (start + num_bytes > end) continue;
+    *offset = start;
+    const uint64 head_bytes = start - extent->offset;
+    const uint64 tail_bytes = end - start - num_bytes;
+    if (head_bytes == 0 && tail_bytes == 0) {
+      memmove(extent, extent + 1,
+              (h->num_free_extents - i - 1) * sizeof(Extent));
+      --h->num_free_extents;
+    } else if (head_bytes == 0) {
+      extent->offset += num_bytes;
+      extent->num_bytes = tail_bytes;
+    } else if (tail_bytes == 0) {
+      extent->num_bytes = head_bytes;
+    } else {
+      // Both ends stay free, the segment separates them.
+      memmove(extent + 2, extent + 1,
+              (h->num_free_extents - i - 1) * sizeof(Extent));
+      ++h->num_free_extents;
+      extent->num_bytes = head_bytes;
+      extent[1] = {start + num_bytes, tail_bytes};
+    }
+    return true;
+  }
+  return false;
+}
+
+void SharedTensorArena::FreeExtent(uint64 offset, uint64 num_bytes) {
+  Header* h = header();
+  Extent* extents = free_extents();
+  Extent* const end = extents + h->num_free_extents;
+  Extent* next = std::lower_bound(
+      extents, end, offset,
+      [](const Extent& e, uint64 offset) { return e.offset < offset; });
+  Extent* prev = next == extents ? nullptr : next - 1;
+  const bool merge_prev =
+      prev != nullptr && prev->offset + prev->num_bytes == offset;
+  const bool merge_next = next != end && offset + num_bytes == next->offset;
+  if (merge_prev && merge_next) {
+    prev->num_bytes += num_bytes + next->num_bytes;
+    memmove(next, next + 1, (end - next - 1) * sizeof(Extent));
+    --h->num_free_extents;
+  } else if (merge_prev) {
+    prev->num_bytes += num_bytes;
+  } else if (merge_next) {
+    next->offset = offset;
+    next->num_bytes += num_bytes;
+  } else {
+    memmove(next + 1, next, (end - next) * sizeof(Extent));
+    next->offset = offset;
+    next->num_bytes = num_bytes;
+    ++h->num_free_extents;
+  }
+}
+
+bool SharedTensorArena::IsValidSegment(const IndexEntry& entry) const {
+  const Header* h = header();
+  const uint64 end = h->data_offset + h->capacity_bytes;
+  return entry.offset >= h->data_offset && entry.offset % kPageBytes == 0 &&
+         entry.offset <= end && entry.num_bytes <= end - entry.offset &&
+         SegmentBytes(entry.num_bytes) <= end - entry.offset;
+}
+
+bool SharedTensorArena::IsOwnerAlive(const IndexEntry& entry) {
+  if (entry.owner_slot >= kMaxProcesses ||
+      header()->process_generation[entry.owner_slot] !=
+          entry.owner_generation) {
+    return false;
+  }
+  if (entry.owner_slot == process_slot_) return true;
+  struct flock lock;
+  InitProcessLock(entry.owner_slot, F_WRLCK, &lock);
+  if (fcntl(fd_, F_OFD_GETLK, &lock) != 0) {
+    // Can not tell, keep waiting for the owner.
+    return true;
+  }
+  return lock.l_type != F_UNLCK;
+}
+
+void SharedTensorArena::StartFill(IndexEntry* entry) {
+  entry->owner_slot = process_slot_;
+  entry->owner_generation = process_generation_;
+  entry->state.store(kSegmentFilling, std::memory_order_relaxed);
+}
+
+void SharedTensorArena::MapSegment(uint64 offset, uint64 num_bytes,
+                                   bool shared) {
+  // Replacing the mapping in place keeps the address of the segment.  The
+  // private pages of a copy-on-write mapping go away with it.
+  const uint64 mapped_bytes = SegmentBytes(num_bytes);
+  const int flags =
+      (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_NORESERVE | MAP_FIXED;
+  void* p = mmap(base_ + offset, mapped_bytes, PROT_READ | PROT_WRITE, flags,
+                 fd_, offset);
+  if (p == MAP_FAILED) {
+    LOG(WARNING) << "Failed to remap " << mapped_bytes << " bytes at offset "
+                 << offset << " of " << path_ << ": " << strerror(errno);
+    return;
+  }
+  // The advice belongs to the mapping replaced.
+  if (huge_pages_ == HugePages::kTransparent &&
+      SegmentAlignment(num_bytes) == kHugePageBytes) {
+    madvise(p, mapped_bytes, MADV_HUGEPAGE);
+  }
+}
+
+Status SharedTensorArena::Attach(StringPiece key, uint64 num_bytes,
+                                 void** data, bool* created) {
+  // Keys are compared as C strings.
+  const string key_str = SegmentKey(key);
+  if (key.empty() || key_str.size() >= kMaxKeyBytes) {
+    return errors::InvalidArgument("Invalid shared tensor key: ", key);
+  }
+
+  Header* h = header();
+  const uint64 deadline_micros = EnvTime::NowMicros() + wait_timeout_micros_;
+  while (true) {
+    IndexEntry* entry;
+    {
+      mutex_lock ml(mu_);
+      if (exclusive_holds_.count(key_str) > 0) {
+        return errors::AlreadyExists("Shared tensor ", key,
+                                     " is held exclusively by this process");
+      }
+      ScopedLock l(&h->mutex);
+      entry = FindSlot(key_str);
+      if (entry == nullptr) {
+        ReclaimUnheld(EnvTime::NowMicros());
+        entry = FindSlot(key_str);
+      }
+      if (entry == nullptr) {
+        DropDeadHolds(EnvTime::NowMicros());
+        while (entry == nullptr && EvictColdest()) {
+          entry = FindSlot(key_str);
+        }
+      }
+      if (entry == nullptr) {
+        return errors::ResourceExhausted("Shared tensor arena ", path_,
+                                         " has no free index slot");
+      }
+      if (entry->key[0] == '\0') {
+        const uint64 allocated_bytes = SegmentBytes(num_bytes);
+        const uint64 alignment = SegmentAlignment(num_bytes);
+        uint64 offset;
+        if (!AllocateExtent(allocated_bytes, alignment, &offset)) {
+          // Reclaiming may free the slot we were about to take.
+          ReclaimUnheld(EnvTime::NowMicros());
+          bool allocated = AllocateExtent(allocated_bytes, alignment, &offset);
+          if (!allocated) DropDeadHolds(EnvTime::NowMicros());
+          while (!allocated && EvictColdest()) {
+            allocated = AllocateExtent(allocated_bytes, alignment, &offset);
+          }
+          if (!allocated) {
+            return errors::ResourceExhausted(
+                "Shared tensor arena ", path_, " is full, can not allocate ",
+                num_bytes, " bytes");
+          }
+          entry = FindSlot(key_str);
+        }
+        // The extent may still be mapped copy-on-write from a segment this
+        // process held before.  The placement applies to the pages allocated
+        // from now on.
+        MapSegment(offset, num_bytes, /*shared=*/true);
+        if (numa_node_ >= 0) {
+          PreferNumaNode(base_ + offset, allocated_bytes, numa_node_);
+        }
+        // Running out of huge pages on a fault kills the process, take them
+        // up front instead.
+        if (huge_pages_ == HugePages::kHugetlbfs &&
+            fallocate(fd_, 0, offset, allocated_bytes) != 0) {
+          const int error = errno;
+          FreeExtent(offset, allocated_bytes);
+          return errors::ResourceExhausted(
+              "Can not allocate ", allocated_bytes, " bytes of huge pages for ",
+              "shared tensor ", key, ": ", strerror(error));
+        }
+        entry->offset = offset;
+        entry->num_bytes = num_bytes;
+        entry->numa_node = std::max(numa_node_, 0);
+        memset(entry->holders, 0, sizeof(entry->holders));
+        StartFill(entry);
+        strncpy(entry->key, key_str.c_str(), kMaxKeyBytes);
+        h->allocated_bytes += allocated_bytes;
+        ++h->num_segments;
+        if (alignment == kHugePageBytes) h->huge_page_bytes += allocated_bytes;
+        Hold(entry);
+
+        *data = base_ + entry->offset;
+        *created = true;
+        return Status::OK();
+      }
+
+      if (entry->num_bytes != num_bytes) {
+        return errors::FailedPrecondition(
+            "Shared tensor ", key, " holds ", entry->num_bytes,
+            " bytes, expected ", num_bytes);
+      }
+      if (!IsValidSegment(*entry)) {
+        return errors::DataLoss("Shared tensor ", key, " of ", path_,
+                                " lies outside of the data region");
+      }
+      const uint32 state = entry->state.load(std::memory_order_acquire);
+      if (state == kSegmentReady) {
+        if (local_holds_.find(key_str) == local_holds_.end()) {
+          MapSegment(entry->offset, num_bytes, /*shared=*/false);
+        }
+        Hold(entry);
+        *data = base_ + entry->offset;
+        *created = false;
+        return Status::OK();
+      }
+      if (state != kSegmentFilling || !IsOwnerAlive(*entry)) {
+        if (state == kSegmentFilling) {
+          LOG(WARNING) << "The process filling shared tensor " << key
+                       << " died, taking over";
+        }
+        StartFill(entry);
+        Hold(entry);
+        MapSegment(entry->offset, num_bytes, /*shared=*/true);
+        *data = base_ + entry->offset;
+        *created = true;
+        return Status::OK();
+      }
+    }
+
+    const uint64 now_micros = EnvTime::NowMicros();
+    if (now_micros >= deadline_micros) {
+      return errors::DeadlineExceeded("Timed out waiting for shared tensor ",
+                                      key, " to be filled");
+    }
+    FutexWait(&entry->state, kSegmentFilling,
+              std::min<int64>(deadline_micros - now_micros, kOwnerPollMicros));
+  }
+}
+
+void SharedTensorArena::FinishFill(StringPiece key, const void* data,
+                                   const Status& fill_status) {
+  const string key_str = SegmentKey(key);
+  if (key.empty() || key_str.size() >= kMaxKeyBytes) return;
+  IndexEntry* entry;
+  {
+    ScopedLock l(&header()->mutex);
+    entry = FindSlot(key_str);
+    if (entry == nullptr || entry->key[0] == '\0' ||
+        base_ + entry->offset != data ||
+        entry->state.load(std::memory_order_relaxed) != kSegmentFilling ||
+        entry->owner_slot != process_slot_ ||
+        entry->owner_generation != process_generation_) {
+      return;
+    }
+    if (fill_status.ok()) {
+      MapSegment(entry->offset, entry->num_bytes, /*shared=*/false);
+    } else {
+      LOG(WARNING) << "Failed to fill shared tensor " << key << ": "
+                   << fill_status;
+    }
+    entry->state.store(fill_status.ok() ? kSegmentReady : kSegmentFailed,
+                       std::memory_order_release);
+  }
+  FutexWakeAll(&entry->state);
+}
+
+void SharedTensorArena::Hold(IndexEntry* entry) {
+  if (local_holds_[entry->key]++ == 0) entry->SetHolder(process_slot_);
+}
+
+bool SharedTensorArena::HoldExclusively(StringPiece key) {
+  const string key_str = SegmentKey(key);
+  mutex_lock ml(mu_);
+  auto it = local_holds_.find(key_str);
+  if (it == local_holds_.end() || it->second != 1) return false;
+  exclusive_holds_.insert(key_str);
+  return true;
+}
+
+void SharedTensorArena::Release(StringPiece key, const void* data) {
+  const string key_str = SegmentKey(key);
+  mutex_lock ml(mu_);
+  auto it = local_holds_.find(key_str);
+  if (it == local_holds_.end() || --it->second > 0) return;
+  local_holds_.erase(it);
+  // Remapping below drops whatever the exclusive holder wrote.
+  exclusive_holds_.erase(key_str);
+
+  ScopedLock l(&header()->mutex);
+  IndexEntry* entry = FindSlot(key_str);
+  if (entry == nullptr || entry->key[0] == '\0' ||
+      base_ + entry->offset != data) {
+    return;
+  }
+  // Drops the pages this process copied on write, if any.
+  MapSegment(entry->offset, entry->num_bytes, /*shared=*/true);
+  entry->ClearHolder(process_slot_);
+  if (!entry->IsHeld()) {
+    entry->released_micros = EnvTime::NowMicros();
+    if (reclaim_grace_micros_ <= 0) FreeSegment(entry);
+  }
+}
+
+void SharedTensorArena::DropHolds(int slot, uint64 now_micros) {
+  const uint32 capacity = header()->index_capacity;
+  IndexEntry* entries = index();
+  for (uint32 i = 0; i < capacity; ++i) {
+    IndexEntry* entry = &entries[i];
+    if (entry->key[0] == '\0' || !entry->HasHolder(slot)) continue;
+    entry->ClearHolder(slot);
+    if (!entry->IsHeld()) entry->released_micros = now_micros;
+  }
+}
+
+int64 SharedTensorArena::ReclaimUnheld(uint64 now_micros) {
+  const uint32 capacity = header()->index_capacity;
+  IndexEntry* entries = index();
+  int64 num_reclaimed = 0;
+  for (uint32 i = 0; i < capacity; ++i) {
+    IndexEntry* entry = &entries[i];
+    if (entry->key[0] == '\0' || entry->IsHeld()) continue;
+    if (entry->released_micros + reclaim_grace_micros_ > now_micros) continue;
+    FreeSegment(entry);
+    ++num_reclaimed;
+  }
+  return num_reclaimed;
+}
+
+bool SharedTensorArena::EvictColdest() {
+  const uint32 capacity = header()->index_capacity;
+  IndexEntry* entries = index();
+  IndexEntry* coldest = nullptr;
+  for (uint32 i = 0; i < capacity; ++i) {
+    IndexEntry* entry = &entries[i];
+    if (entry->key[0] == '\0' || entry->IsHeld()) continue;
+    if (coldest == nullptr ||
+        entry->released_micros < coldest->released_micros) {
+      coldest = entry;
+    }
+  }
+  if (coldest == nullptr) return false;
+  LOG(INFO) << "Evicting shared tensor " << coldest->key << " of "
+            << coldest->num_bytes << " bytes to make room";
+  FreeSegment(coldest);
+  ++header()->num_evictions;
+  return true;
+}
+
+void SharedTensorArena::FreeSegment(IndexEntry* entry) {
+  Header* h = header();
+  const uint64 allocated_bytes = SegmentBytes(entry->num_bytes);
+  // Hand the pages back to the system right away, the file keeps its size.
+  if (fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, entry->offset,
+                allocated_bytes) != 0) {
+    LOG(WARNING) << "Failed to free the pages of shared tensor " << entry->key
+                 << ": " << strerror(errno);
+  }
+  FreeExtent(entry->offset, allocated_bytes);
+  h->allocated_bytes -= allocated_bytes;
+  h->reclaimed_bytes += allocated_bytes;
+  --h->num_segments;
+  if (SegmentAlignment(entry->num_bytes) == kHugePageBytes) {
+    h->huge_page_bytes -= allocated_bytes;
+  }
+  VLOG(1) << "Reclaimed shared tensor " << entry->key << " of "
+          << entry->num_bytes << " bytes";
+  entry->key[0] = '\0';
+  entry->state.store(kSegmentDeleted, std::memory_order_relaxed);
+  // Processes still waiting for the segment to be filled start over.
+  FutexWakeAll(&entry->state);
+}
+
+int64 SharedTensorArena::Reclaim() {
+  ScopedLock l(&header()->mutex);
+  const uint64 now_micros = EnvTime::NowMicros();
+  DropDeadHolds(now_micros);
+  return ReclaimUnheld(now_micros);
+}
+
+void SharedTensorArena::DropDeadHolds(uint64 now_micros) {
+  // A process slot nobody holds the lock of belongs to a dead process.  Slots
+  // never claimed hold nothing.
+  for (uint32 slot = 0; slot < kMaxProcesses; ++slot) {
+    if (slot == process_slot_ || header()->process_generation[slot] == 0) {
+      continue;
+    }
+    struct flock lock;
+    InitProcessLock(slot, F_WRLCK, &lock);
+    if (fcntl(fd_, F_OFD_GETLK, &lock) == 0 && lock.l_type == F_UNLCK) {
+      DropHolds(slot, now_micros);
+    }
+  }
+}
+
+int SharedTensorArena::NumHolders(StringPiece key) {
+  const string key_str = SegmentKey(key);
+  if (key.empty() || key_str.size() >= kMaxKeyBytes) return 0;
+  ScopedLock l(&header()->mutex);
+  IndexEntry* entry = FindSlot(key_str);
+  if (entry == nullptr || entry->key[0] == '\0') return 0;
+  return entry->NumHolders();
+}
+
+string SharedTensorArena::SegmentKey(StringPiece key) const {
+  if (!numa_replicas_) return string(key);
+  return absl::StrCat(key, "@", numa_node_);
+}
+
+bool SharedTensorArena::Contains(StringPiece key) {
+  const string key_str = SegmentKey(key);
+  if (key.empty() || key_str.size() >= kMaxKeyBytes) return false;
+  ScopedLock l(&header()->mutex);
+  IndexEntry* entry = FindSlot(key_str);
+  return entry != nullptr && entry->key[0] != '\0' &&
+         entry->state.load(std::memory_order_relaxed) == kSegmentReady;
+}
+
+SharedTensorArena::Stats SharedTensorArena::GetStats() {
+  Header* h = header();
+  ScopedLock l(&h->mutex);
+  Stats stats;
+  stats.capacity_bytes = h->capacity_bytes;
+  stats.allocated_bytes = h->allocated_bytes;
+  stats.num_segments = h->num_segments;
+  stats.huge_page_bytes = h->huge_page_bytes;
+  stats.num_evictions = h->num_evictions;
+  stats.reclaimed_bytes = h->reclaimed_bytes;
+  stats.num_free_extents = h->num_free_extents;
+  const Extent* extents = free_extents();
+  for (uint64 i = 0; i < h->num_free_extents; ++i) {
+    stats.free_bytes += extents[i].num_bytes;
+    stats.largest_free_extent_bytes =
+        std::max(stats.largest_free_extent_bytes, extents[i].num_bytes);
+  }
+  const uint32 capacity = h->index_capacity;
+  IndexEntry* entries = index();
+  for (uint32 i = 0; i < capacity; ++i) {
+    const IndexEntry& entry = entries[i];
+    if (entry.key[0] == '\0') continue;
+    const size_t node =
+        std::min(std::max(entry.numa_node, 0), kMaxNumaNodes - 1);
+    if (stats.nodes.size() <= node) stats.nodes.resize(node + 1);
+    Stats::NodeStats* node_stats = &stats.nodes[node];
+    node_stats->allocated_bytes += SegmentBytes(entry.num_bytes);
+    const int num_holders = entry.NumHolders();
+    if (num_holders > 1) {
+      node_stats->saved_bytes += (num_holders - 1) * entry.num_bytes;
+    }
+  }
+  return stats;
+}
+
+Status SharedTensorArena::GetHugePageCoverage(uint64* resident_bytes,
+                                              uint64* huge_page_bytes) {
+  *resident_bytes = 0;
+  *huge_page_bytes = 0;
+  FILE* smaps = fopen("/proc/self/smaps", "r");
+  if (smaps == nullptr) {
+    return IOError("Failed to open /proc/self/smaps", errno);
+  }
+  // Mappings start with a line "<from>-<to> <perms> ... <path>", followed by
+  // lines "<field>: <n> kB".
+  bool in_arena = false;
+  char line[PATH_MAX + 256];
+  while (fgets(line, sizeof(line), smaps) != nullptr) {
+    StringPiece l(line);
+    str_util::ConsumeSuffix(&l, "\n");
+    const size_t colon = l.find(':');
+    const bool is_field = colon != StringPiece::npos &&
+                          l.substr(0, colon).find(' ') == StringPiece::npos &&
+                          l.substr(0, colon).find('-') == StringPiece::npos;
+    if (!is_field) {
+      in_arena = str_util::EndsWith(l, path_);
+      continue;
+    }
+    if (!in_arena) continue;
+    const StringPiece field = l.substr(0, colon);
+    const uint64 bytes = strtoull(line + colon + 1, nullptr, 10) * 1024;
+    if (field == "Rss" || field == "Shared_Hugetlb" ||
+        field == "Private_Hugetlb") {
+      *resident_bytes += bytes;
+    }
+    if (field == "ShmemPmdMapped" || field == "FilePmdMapped" ||
+        field == "Shared_Hugetlb" || field == "Private_Hugetlb") {
+      *huge_page_bytes += bytes;
+    }
+  }
+  fclose(smaps);
+  return Status::OK();
+}
+
+}  // namespace tensorflow
+
+#else  // defined(__linux__) && !defined(IS_MOBILE_PLATFORM)
+
+#include <atomic>
+
+#include "tensorflow/core/platform/errors.h"
+
+namespace tensorflow {
+
+namespace {
+
+std::atomic<int64> num_fallbacks{0};
+
+Status Unsupported() {
+  return errors::Unimplemented(
+      "The shared tensor arena is not supported on this platform");
+}
+
+}  // namespace
+
+Status SharedTensorArena::Open(const Options& options,
+                               std::unique_ptr<SharedTensorArena>* arena) {
+  return Unsupported();
+}
+
+Status SharedTensorArena::Connect(const string& socket_path,
+                                  const Options& options,
+                                  std::unique_ptr<SharedTensorArena>* arena) {
+  return Unsupported();
+}
+
+Status SharedTensorArena::Serve(int connection) { return Unsupported(); }
+
+SharedTensorArena* SharedTensorArena::Global() { return nullptr; }
+
+Status SharedTensorArena::ConfigureGlobal(const Options& options,
+                                          const string& socket_path) {
+  return Status::OK();
+}
+
+void SharedTensorArena::GlobalOptionsFromEnv(Options* options,
+                                             string* socket_path) {}
+
+SharedTensorArena* SharedTensorArena::GlobalIfOpen() { return nullptr; }
+
+void SharedTensorArena::RecordFallback() {
+  num_fallbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64 SharedTensorArena::NumFallbacks() {
+  return num_fallbacks.load(std::memory_order_relaxed);
+}
+
+// No arena is ever opened, so none of the following is ever called.
+
+SharedTensorArena::~SharedTensorArena() {}
+
+Status SharedTensorArena::Attach(StringPiece key, uint64 num_bytes,
+                                 void** data, bool* created) {
+  return Unsupported();
+}
+
+bool SharedTensorArena::HoldExclusively(StringPiece key) { return false; }
+
+void SharedTensorArena::FinishFill(StringPiece key, const void* data,
+                                   const Status& fill_status) {}
+
+void SharedTensorArena::Release(StringPiece key, const void* data) {}
+
+int64 SharedTensorArena::Reclaim() { return 0; }
+
+bool SharedTensorArena::Contains(StringPiece key) { return false; }
+
+SharedTensorArena::Stats SharedTensorArena::GetStats() { return Stats(); }
+
+Status SharedTensorArena::GetHugePageCoverage(uint64* resident_bytes,
+                                              uint64* huge_page_bytes) {
+  return Unsupported();
+}
+
+int SharedTensorArena::NumHolders(StringPiece key) { return 0; }
+
+}  // namespace tensorflow
+
+#endif  // defined(__linux__) && !defined(IS_MOBILE_PLATFORM)
@@ -0,0 +1,382 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_FRAMEWORK_SHARED_TENSOR_ARENA_H_
+#define TENSORFLOW_CORE_FRAMEWORK_SHARED_TENSOR_ARENA_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A node-wide arena in shared memory holding tensors that are shared between
+// the processes on a node.
+//
+// The arena is a single large file on a tmpfs mount.  It starts with a header
+// and a hash index mapping a tensor key to the offset of its bytes, followed by
+// the list of free extents and the data region.  All accesses to the index are
+// serialized by a robust, process-shared mutex stored in the header, so a
+// process attaching to a tensor that is already present only pays for one
+// mmap of the whole arena (done once per process) plus an index lookup.
+//
+// The file is sized to "capacity_bytes" up front but, being on tmpfs, only the
+// pages actually written to take memory.
+//
+// Each segment carries a state word.  The process creating a segment owns its
+// fill and marks it READY (or FAILED) with FinishFill().  Processes attaching
+// to a segment that is being filled block on the state word until it is READY,
+// and take the fill over if it FAILED or its owner died.  A fleet of processes
+// starting the same model at once thus reads every tensor from disk once.
+// Liveness of the owner is tracked by a byte-range lock held on the arena
+// file, which works across PID namespaces.
+//
+// Once READY, the pages of a segment are mapped copy-on-write in every
+// process.  A process writing to a shared tensor, e.g. through an op
+// updating a restored variable in place, gets private copies of the pages it
+// writes, and never corrupts the tensor for the other processes.
+//
+// Segments are reference counted.  Each segment records which processes hold
+// it, and each process counts its own Attach() and Release() calls.  A segment
+// no process held for "reclaim_grace_micros" is reclaimed: its pages are
+// returned to the system and its extent to the free list.  The holds of a
+// process that died are dropped by the next Reclaim(), or when its process
+// slot is claimed again.  When the arena runs out of room, the segments no
+// process holds are evicted right away, least recently released first, before
+// Attach() gives up.
+//
+// Large segments can be backed by 2 MiB pages, either transparent huge pages
+// of the tmpfs mount or a hugetlbfs mount, to take TLB and page table pressure
+// off the processes mapping the same weights.  The process creating the arena
+// picks the kind of pages for all of them.
+//
+// The pages of a segment are placed on the NUMA node of the process filling
+// it.  Optionally, each node gets a replica of every segment, and processes
+// only attach to the replicas on their own node, trading memory for local
+// accesses to hot models.
+//
+// The arena can be owned by a daemon on the node, which hands it out over a
+// Unix domain socket, so that processes need no access to its path.
+class SharedTensorArena {
+ public:
+  enum class HugePages {
+    // 4 KiB pages only.
+    kNone = 0,
+    // Segments of at least 2 MiB are aligned and sized to 2 MiB, and their
+    // mappings advised to use transparent huge pages.  Takes the tmpfs mount
+    // to allow them, e.g. shmem_enabled=advise.
+    kTransparent = 1,
+    // Every segment is made of 2 MiB pages.  Takes "path" to be on a
+    // hugetlbfs mount with enough pages reserved.
+    kHugetlbfs = 2,
+  };
+
+  struct Options {
+    Options() {}
+    // Path of the arena file.  Every process on the node has to use the same.
+    string path = "/dev/shm/serving_memorys/tensor_arena";
+    // Size of the data region.
+    uint64 capacity_bytes = 64ULL << 30;
+    // Number of slots of the index, i.e. the maximum number of tensors.
+    uint32 index_capacity = 1 << 16;
+    // How long Attach() waits for another process to fill a segment.
+    int64 wait_timeout_micros = 300 * 1000 * 1000;
+    // How long a segment no process holds is kept around, in case a process
+    // loading the same model comes along.
+    int64 reclaim_grace_micros = 60 * 1000 * 1000;
+    // Pages backing the segments, if this process creates the arena.
+    HugePages huge_pages = HugePages::kNone;
+    // Permissions of the arena file, if this process creates it, regardless
+    // of the umask.  Every process using the arena, including the clients of
+    // a daemon, opens the file for reading and writing.
+    uint32 file_mode = 0666;
+    // NUMA node of this process.  Negative picks the node of most of the CPUs
+    // it may run on.
+    int numa_node = -1;
+    // Whether this process attaches to a replica of each segment on its NUMA
+    // node.  Has no effect on machines with a single node.
+    bool numa_replicas = false;
+  };
+
+  struct Stats {
+    uint64 capacity_bytes = 0;
+    // Bytes of the data region handed out to segments.
+    uint64 allocated_bytes = 0;
+    uint64 num_segments = 0;
+    // Bytes of "allocated_bytes" in segments aligned to huge pages.
+    uint64 huge_page_bytes = 0;
+    // Segments reclaimed before the end of their grace period to make room.
+    uint64 num_evictions = 0;
+    // Bytes of the segments reclaimed or evicted since the arena was created.
+    uint64 reclaimed_bytes = 0;
+    // The free bytes of the data region, in "num_free_extents" extents the
+    // largest of which has "largest_free_extent_bytes".  The arena is
+    // fragmented when the latter falls well short of "free_bytes".
+    uint64 free_bytes = 0;
+    uint64 num_free_extents = 0;
+    uint64 largest_free_extent_bytes = 0;
+
+    struct NodeStats {
+      // Bytes of the segments placed on the node.
+      uint64 allocated_bytes = 0;
+      // Bytes the processes holding these segments would take on top of them
+      // without sharing.
+      uint64 saved_bytes = 0;
+    };
+    // Indexed by NUMA node.  Segments of processes that are not on a
+    // particular node count towards node 0.
+    std::vector<NodeStats> nodes;
+  };
+
+  // Opens the arena at "options.path", creating and initializing it if no
+  // process did so yet.  Uses the huge pages of the arena if it exists.
+  static Status Open(const Options& options,
+                     std::unique_ptr<SharedTensorArena>* arena);
+
+  // Opens the arena of the daemon listening on "socket_path", which sends the
+  // arena file over the socket.  "options.path" is ignored.
+  static Status Connect(const string& socket_path, const Options& options,
+                        std::unique_ptr<SharedTensorArena>* arena);
+
+  // Answers the request of a process connected to the socket of the daemon
+  // owning this arena on "connection": the arena file for Connect(), or the
+  // statistics of the arena in the Prometheus text format for a "stats"
+  // request.  Does not close "connection".
+  Status Serve(int connection);
+
+  // Returns the arena of this process, opened with the default options on
+  // first use, with a background thread reclaiming unused segments.  The path
+  // and huge pages can be set with TF_SHARED_TENSOR_ARENA_PATH and
+  // TF_SHARED_TENSOR_HUGE_PAGES ("none", "transparent" or "hugetlbfs"), and
+  // NUMA replicas turned on with TF_SHARED_TENSOR_NUMA_REPLICAS=true.  With
+  // TF_SHARED_TENSOR_ARENA_SOCKET set, connects to the daemon listening on it
+  // instead of opening the path.
+  // Returns nullptr if the arena can not be opened.
+  static SharedTensorArena* Global();
+
+  // Makes Global() open the arena with "options" instead of the environment
+  // variables, or connect to the daemon listening on "socket_path" if it is
+  // not empty.  Returns FailedPrecondition once Global() has been called.
+  // Start from GlobalOptionsFromEnv() to only override some of the options.
+  static Status ConfigureGlobal(const Options& options,
+                                const string& socket_path);
+
+  // Overrides "options" and "socket_path" with the environment variables
+  // Global() reads, leaving the fields whose variable is not set untouched.
+  static void GlobalOptionsFromEnv(Options* options, string* socket_path);
+
+  // Returns the arena of this process if Global() opened it, without opening
+  // it otherwise.
+  static SharedTensorArena* GlobalIfOpen();
+
+  // Counts a tensor of this process placed in private memory because it
+  // could not be shared.
+  static void RecordFallback();
+
+  // Returns the number of tensors of this process placed in private memory
+  // because they could not be shared.
+  static int64 NumFallbacks();
+
+  ~SharedTensorArena();
+
+  // Looks up the segment keyed by "key", creating it if it does not exist,
+  // and holds it until the matching Release().
+  // On success "*data" points at its "num_bytes" bytes, and "*created" tells
+  // whether this process now owns the fill of the segment, in which case the
+  // caller has to fill it and then call FinishFill().  Otherwise the segment
+  // is READY.  Blocks while another live process fills the segment.
+  //
+  // The index entry of a segment stands in for a header of its own: its key
+  // and size are checked against "key" and "num_bytes", and its extent
+  // against the data region, before the segment is handed out.
+  //
+  // Returns FailedPrecondition if a segment with the same key but a different
+  // size exists, DataLoss if the index entry of the segment is corrupt,
+  // ResourceExhausted if the arena is full even after evicting every segment
+  // no process holds, DeadlineExceeded if the segment did not become READY
+  // within "wait_timeout_micros", and AlreadyExists if this process holds the
+  // segment exclusively.
+  Status Attach(StringPiece key, uint64 num_bytes, void** data, bool* created);
+
+  // Makes the single hold this process has on the segment keyed by "key"
+  // exclusive until it is released: Attach() of the same key in this process
+  // fails meanwhile.  For a tensor that may be written in place, e.g. once
+  // forwarded to a variable, whose writes must not show through the tensors
+  // of this process with the same key.  Copy-on-write only keeps them from
+  // the other processes.  Returns false if this process holds the segment
+  // more than once, or not at all; the caller has to use a private copy then.
+  bool HoldExclusively(StringPiece key);
+
+  // Publishes the outcome of filling the segment keyed by "key" at "data",
+  // and wakes up the processes waiting for it.  The segment becomes READY if
+  // "fill_status" is OK, and FAILED otherwise, to be filled again by the next
+  // process attaching to it.  Does nothing unless this process owns the fill,
+  // so it is safe to call with a private buffer.
+  void FinishFill(StringPiece key, const void* data, const Status& fill_status);
+
+  // Drops a hold taken by Attach() on the segment keyed by "key" at "data".
+  // Does nothing if this process does not hold it.
+  void Release(StringPiece key, const void* data);
+
+  // Drops the holds of dead processes, and reclaims the segments no process
+  // held for the grace period.  Returns the number of segments reclaimed.
+  int64 Reclaim();
+
+  // Returns true iff a READY segment keyed by "key" exists.
+  bool Contains(StringPiece key);
+
+  // Returns true iff "ptr" points into the mapping of the arena in this
+  // process, e.g. into the bytes of a segment returned by Attach().
+  bool ContainsAddress(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return p >= base_ && p < base_ + mapped_size_;
+  }
+
+  Stats GetStats();
+
+  // Reads from /proc/self/smaps how many bytes of the arena this process has
+  // resident, and how many of them are mapped by huge pages.
+  Status GetHugePageCoverage(uint64* resident_bytes, uint64* huge_page_bytes);
+
+  HugePages huge_pages() const { return huge_pages_; }
+
+  // The NUMA node of this process, or -1 if it is not on a particular one.
+  int numa_node() const { return numa_node_; }
+
+  // Returns the number of processes holding the segment keyed by "key".
+  int NumHolders(StringPiece key);
+
+  const string& path() const { return path_; }
+
+ private:
+  struct Header;
+  struct IndexEntry;
+  struct Extent;
+  class ScopedLock;
+
+  SharedTensorArena(const Options& options, int fd, char* base,
+                    uint64 mapped_size);
+
+  // Opens the arena in file "fd", taking ownership of it.
+  static Status OpenFile(const Options& options, int fd,
+                         std::unique_ptr<SharedTensorArena>* arena);
+
+  // Takes a free process slot, identifying this arena object as the owner of
+  // the fills it starts for as long as it is open.
+  Status ClaimProcessSlot();
+
+  // Returns the key of the segment this process uses for "key": the replica
+  // on its NUMA node, if it uses replicas.
+  string SegmentKey(StringPiece key) const;
+
+  Header* header() const;
+  IndexEntry* index() const;
+  Extent* free_extents() const;
+
+  // Returns the index slot holding "key", or the slot where it would be
+  // inserted, or nullptr if the index is full.
+  // REQUIRES: the arena lock is held.
+  IndexEntry* FindSlot(StringPiece key);
+
+  // Returns the alignment and the allocated size of a segment of "num_bytes".
+  uint64 SegmentAlignment(uint64 num_bytes) const;
+  uint64 SegmentBytes(uint64 num_bytes) const;
+
+  // Takes "num_bytes" at an offset aligned to "alignment" from the free list,
+  // first fit.  Returns false if no free extent is large enough.
+  // REQUIRES: the arena lock is held.
+  bool AllocateExtent(uint64 num_bytes, uint64 alignment, uint64* offset);
+
+  // Returns an extent to the free list, merging it with its neighbours.
+  // REQUIRES: the arena lock is held.
+  void FreeExtent(uint64 offset, uint64 num_bytes);
+
+  // Takes a hold on "entry" for this process.
+  // REQUIRES: "mu_" and the arena lock are held.
+  void Hold(IndexEntry* entry) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Clears the holder bit of process slot "slot" from every segment.
+  // REQUIRES: the arena lock is held.
+  void DropHolds(int slot, uint64 now_micros);
+
+  // Drops the holds of the processes that died.
+  // REQUIRES: the arena lock is held.
+  void DropDeadHolds(uint64 now_micros);
+
+  // Reclaims the segments no process held for the grace period.
+  // REQUIRES: the arena lock is held.
+  int64 ReclaimUnheld(uint64 now_micros);
+
+  // Reclaims the segment no process held for the longest time, even within
+  // its grace period.  Returns false if every segment is held.
+  // REQUIRES: the arena lock is held.
+  bool EvictColdest();
+
+  // Punches the pages of "entry" out of the file and frees its slot.
+  // REQUIRES: the arena lock is held.
+  void FreeSegment(IndexEntry* entry);
+
+  // Returns true iff the extent of "entry" lies within the data region.
+  // REQUIRES: the arena lock is held.
+  bool IsValidSegment(const IndexEntry& entry) const;
+
+  // Returns true iff the process owning the fill of "entry" is still alive.
+  // REQUIRES: the arena lock is held.
+  bool IsOwnerAlive(const IndexEntry& entry);
+
+  // Maps the pages of the segment at "offset" in this process: shared, to be
+  // filled, or copy-on-write once it is READY.
+  void MapSegment(uint64 offset, uint64 num_bytes, bool shared);
+
+  // Makes this process the owner of the fill of "entry".
+  // REQUIRES: the arena lock is held.
+  void StartFill(IndexEntry* entry);
+
+  const string path_;
+  const int64 wait_timeout_micros_;
+  const int64 reclaim_grace_micros_;
+  const int numa_node_;
+  const bool numa_replicas_;
+  const int fd_;
+  char* const base_;
+  const uint64 mapped_size_;
+  // Read from the header by Open().
+  HugePages huge_pages_ = HugePages::kNone;
+  // Claimed by ClaimProcessSlot(), before Open() hands the arena out.  Of the
+  // type of IndexEntry::owner_slot it is compared with.
+  uint32 process_slot_ = 0;
+  uint64 process_generation_ = 0;
+
+  mutex mu_;
+  // Number of Attach() calls not yet released, by key.  The segment holds the
+  // holder bit of this process iff its key is in the map.
+  std::unordered_map<string, int> local_holds_ TF_GUARDED_BY(mu_);
+  // Keys held exclusively, see HoldExclusively().  Each is held once.
+  std::unordered_set<string> exclusive_holds_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedTensorArena);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_SHARED_TENSOR_ARENA_H_
@@ -0,0 +1,570 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/shared_tensor_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <thread>  // NOLINT
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+SharedTensorArena::Options TestOptions(const string& name) {
+  SharedTensorArena::Options options;
+  options.path = strings::StrCat(testing::TmpDir(), "/", name);
+  options.capacity_bytes = 1 << 20;
+  options.index_capacity = 16;
+  unlink(options.path.c_str());
+  return options;
+}
+
+TEST(SharedTensorArenaTest, AttachCreatesOnce) {
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("create_once"), &arena));
+
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data) % 64);
+  memset(data, 7, 100);
+  EXPECT_FALSE(arena->Contains("weights"));
+  arena->FinishFill("weights", data, Status::OK());
+
+  void* attached = nullptr;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &attached, &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(data, attached);
+  EXPECT_TRUE(arena->Contains("weights"));
+  EXPECT_FALSE(arena->Contains("bias"));
+
+  SharedTensorArena::Stats stats = arena->GetStats();
+  EXPECT_EQ(1, stats.num_segments);
+  EXPECT_EQ(4096, stats.allocated_bytes);
+}
+
+// Processes of other users, e.g. the clients of a daemon, need to open the
+// arena for writing whatever the umask of the process creating it.
+TEST(SharedTensorArenaTest, FileModeIgnoresUmask) {
+  SharedTensorArena::Options options = TestOptions("file_mode");
+  options.file_mode = 0660;
+  const mode_t old_umask = umask(077);
+  std::unique_ptr<SharedTensorArena> arena;
+  const Status status = SharedTensorArena::Open(options, &arena);
+  umask(old_umask);
+  TF_ASSERT_OK(status);
+
+  struct stat statbuf;
+  ASSERT_EQ(0, stat(options.path.c_str(), &statbuf));
+  EXPECT_EQ(0660, statbuf.st_mode & 07777);
+}
+
+TEST(SharedTensorArenaTest, SizeMismatch) {
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("size_mismatch"), &arena));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(errors::IsFailedPrecondition(
+      arena->Attach("weights", 200, &data, &created)));
+}
+
+TEST(SharedTensorArenaTest, Exhausted) {
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("exhausted"), &arena));
+  void* data = nullptr;
+  bool created = false;
+  EXPECT_TRUE(errors::IsResourceExhausted(
+      arena->Attach("too_large", 2 << 20, &data, &created)));
+  for (int i = 0; i < 16; ++i) {
+    TF_ASSERT_OK(arena->Attach(strings::StrCat("t", i), 8, &data, &created));
+  }
+  EXPECT_TRUE(errors::IsResourceExhausted(
+      arena->Attach("one_more", 8, &data, &created)));
+}
+
+TEST(SharedTensorArenaTest, InvalidKey) {
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("invalid_key"), &arena));
+  void* data = nullptr;
+  bool created = false;
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(arena->Attach("", 8, &data, &created)));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      arena->Attach(string(64, 'k'), 8, &data, &created)));
+}
+
+TEST(SharedTensorArenaTest, SharedAcrossProcesses) {
+  const SharedTensorArena::Options options = TestOptions("processes");
+  const int kProcesses = 4;
+  for (int i = 0; i < kProcesses; ++i) {
+    if (fork() == 0) {
+      std::unique_ptr<SharedTensorArena> arena;
+      if (!SharedTensorArena::Open(options, &arena).ok()) _exit(2);
+      void* data = nullptr;
+      bool created = false;
+      if (!arena->Attach("weights", 100, &data, &created).ok()) _exit(2);
+      if (created) {
+        // Give the other processes time to wait for the fill.
+        usleep(50 * 1000);
+        memset(data, 7, 100);
+        arena->FinishFill("weights", data, Status::OK());
+      } else if (static_cast<char*>(data)[99] != 7) {
+        _exit(2);
+      }
+      _exit(created ? 1 : 0);
+    }
+  }
+  int num_created = 0;
+  for (int i = 0; i < kProcesses; ++i) {
+    int status = 0;
+    wait(&status);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_NE(2, WEXITSTATUS(status));
+    num_created += WEXITSTATUS(status);
+  }
+  EXPECT_EQ(1, num_created);
+
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(7, static_cast<char*>(data)[99]);
+}
+
+TEST(SharedTensorArenaTest, FailedFillIsTakenOver) {
+  const SharedTensorArena::Options options = TestOptions("failed_fill");
+  std::unique_ptr<SharedTensorArena> first, second;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &first));
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &second));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(first->Attach("weights", 100, &data, &created));
+  ASSERT_TRUE(created);
+
+  // Only the owner of the fill can finish it.
+  second->FinishFill("weights", data, Status::OK());
+  EXPECT_FALSE(second->Contains("weights"));
+
+  first->FinishFill("weights", data, errors::DataLoss("corrupt checkpoint"));
+  TF_ASSERT_OK(second->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+  second->FinishFill("weights", data, Status::OK());
+  EXPECT_TRUE(first->Contains("weights"));
+}
+
+TEST(SharedTensorArenaTest, WaitTimesOut) {
+  SharedTensorArena::Options options = TestOptions("timeout");
+  options.wait_timeout_micros = 10 * 1000;
+  std::unique_ptr<SharedTensorArena> first, second;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &first));
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &second));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(first->Attach("weights", 100, &data, &created));
+  ASSERT_TRUE(created);
+  EXPECT_TRUE(errors::IsDeadlineExceeded(
+      second->Attach("weights", 100, &data, &created)));
+}
+
+TEST(SharedTensorArenaTest, FillOfDeadProcessIsTakenOver) {
+  const SharedTensorArena::Options options = TestOptions("dead_owner");
+  if (fork() == 0) {
+    std::unique_ptr<SharedTensorArena> arena;
+    if (!SharedTensorArena::Open(options, &arena).ok()) _exit(2);
+    void* data = nullptr;
+    bool created = false;
+    if (!arena->Attach("weights", 100, &data, &created).ok()) _exit(2);
+    // Dies without finishing the fill.
+    _exit(created ? 0 : 2);
+  }
+  int status = 0;
+  wait(&status);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+}
+
+TEST(SharedTensorArenaTest, ReleaseReclaimsAfterGracePeriod) {
+  SharedTensorArena::Options options = TestOptions("grace");
+  options.reclaim_grace_micros = 500 * 1000;
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  arena->FinishFill("weights", data, Status::OK());
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_EQ(1, arena->NumHolders("weights"));
+
+  arena->Release("weights", data);
+  EXPECT_EQ(1, arena->NumHolders("weights"));
+  arena->Release("weights", data);
+  EXPECT_EQ(0, arena->NumHolders("weights"));
+  // Still within the grace period.
+  EXPECT_EQ(0, arena->Reclaim());
+  EXPECT_TRUE(arena->Contains("weights"));
+
+  Env::Default()->SleepForMicroseconds(options.reclaim_grace_micros + 100000);
+  EXPECT_EQ(1, arena->Reclaim());
+  EXPECT_FALSE(arena->Contains("weights"));
+  EXPECT_EQ(0, arena->GetStats().num_segments);
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+}
+
+TEST(SharedTensorArenaTest, ReclaimedSpaceIsReused) {
+  SharedTensorArena::Options options = TestOptions("reuse");
+  options.reclaim_grace_micros = 0;
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* a = nullptr;
+  void* b = nullptr;
+  void* c = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("a", 256 << 10, &a, &created));
+  TF_ASSERT_OK(arena->Attach("b", 256 << 10, &b, &created));
+  TF_ASSERT_OK(arena->Attach("c", 512 << 10, &c, &created));
+  EXPECT_EQ(3, arena->GetStats().num_segments);
+  EXPECT_TRUE(errors::IsResourceExhausted(
+      arena->Attach("d", 512 << 10, &c, &created)));
+
+  // The extents of "a" and "b" are merged, and "d" fits in them.
+  arena->Release("a", a);
+  arena->Release("b", b);
+  EXPECT_EQ(1, arena->GetStats().num_segments);
+  void* d = nullptr;
+  TF_ASSERT_OK(arena->Attach("d", 512 << 10, &d, &created));
+  EXPECT_TRUE(created);
+  EXPECT_EQ(a, d);
+  EXPECT_EQ(1 << 20, arena->GetStats().allocated_bytes);
+}
+
+TEST(SharedTensorArenaTest, FreeExtentStats) {
+  SharedTensorArena::Options options = TestOptions("free_extents");
+  options.reclaim_grace_micros = 0;
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* a = nullptr;
+  void* b = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("a", 256 << 10, &a, &created));
+  TF_ASSERT_OK(arena->Attach("b", 256 << 10, &b, &created));
+  arena->Release("a", a);
+
+  // "a" is free but separated from the tail of the arena by "b".
+  SharedTensorArena::Stats stats = arena->GetStats();
+  EXPECT_EQ(768 << 10, stats.free_bytes);
+  EXPECT_EQ(2, stats.num_free_extents);
+  EXPECT_EQ(512 << 10, stats.largest_free_extent_bytes);
+  EXPECT_EQ(256 << 10, stats.reclaimed_bytes);
+}
+
+TEST(SharedTensorArenaTest, EvictsUnheldSegmentsWhenFull) {
+  SharedTensorArena::Options options = TestOptions("evict");
+  options.reclaim_grace_micros = 3600LL * 1000 * 1000;
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  void* a = nullptr;
+  void* b = nullptr;
+  void* c = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("a", 512 << 10, &a, &created));
+  arena->FinishFill("a", a, Status::OK());
+  TF_ASSERT_OK(arena->Attach("b", 256 << 10, &b, &created));
+  arena->FinishFill("b", b, Status::OK());
+  TF_ASSERT_OK(arena->Attach("c", 256 << 10, &c, &created));
+  arena->FinishFill("c", c, Status::OK());
+  arena->Release("b", b);
+  arena->Release("a", a);
+
+  // "b" was released first, and is enough to make room.
+  void* d = nullptr;
+  TF_ASSERT_OK(arena->Attach("d", 256 << 10, &d, &created));
+  EXPECT_TRUE(created);
+  EXPECT_EQ(b, d);
+  EXPECT_FALSE(arena->Contains("b"));
+  EXPECT_TRUE(arena->Contains("a"));
+  SharedTensorArena::Stats stats = arena->GetStats();
+  EXPECT_EQ(1, stats.num_evictions);
+  EXPECT_EQ(256 << 10, stats.reclaimed_bytes);
+  EXPECT_EQ(0, stats.free_bytes);
+
+  // Held segments are never evicted.
+  arena->FinishFill("d", d, Status::OK());
+  EXPECT_TRUE(errors::IsResourceExhausted(
+      arena->Attach("e", 768 << 10, &d, &created)));
+  EXPECT_TRUE(arena->Contains("c"));
+}
+
+TEST(SharedTensorArenaTest, HoldsOfDeadProcessAreDropped) {
+  SharedTensorArena::Options options = TestOptions("dead_holder");
+  options.reclaim_grace_micros = 0;
+  if (fork() == 0) {
+    std::unique_ptr<SharedTensorArena> arena;
+    if (!SharedTensorArena::Open(options, &arena).ok()) _exit(2);
+    void* data = nullptr;
+    bool created = false;
+    if (!arena->Attach("weights", 100, &data, &created).ok()) _exit(2);
+    arena->FinishFill("weights", data, Status::OK());
+    // Dies without releasing the segment.
+    _exit(0);
+  }
+  int status = 0;
+  wait(&status);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  EXPECT_TRUE(arena->Contains("weights"));
+  EXPECT_EQ(1, arena->Reclaim());
+  EXPECT_FALSE(arena->Contains("weights"));
+  EXPECT_EQ(0, arena->GetStats().allocated_bytes);
+}
+
+TEST(SharedTensorArenaTest, WritesToReadySegmentsArePrivate) {
+  const SharedTensorArena::Options options = TestOptions("copy_on_write");
+  std::unique_ptr<SharedTensorArena> first, second;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &first));
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &second));
+
+  void* filled = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(first->Attach("weights", 8192, &filled, &created));
+  ASSERT_TRUE(created);
+  memset(filled, 7, 8192);
+  first->FinishFill("weights", filled, Status::OK());
+
+  void* attached = nullptr;
+  TF_ASSERT_OK(second->Attach("weights", 8192, &attached, &created));
+  ASSERT_FALSE(created);
+  char* first_bytes = static_cast<char*>(filled);
+  char* second_bytes = static_cast<char*>(attached);
+  EXPECT_EQ(7, second_bytes[8191]);
+
+  second_bytes[0] = 1;
+  first_bytes[8191] = 2;
+  EXPECT_EQ(7, first_bytes[0]);
+  EXPECT_EQ(7, second_bytes[8191]);
+  EXPECT_EQ(1, second_bytes[0]);
+
+  // Releasing drops the private copy.
+  second->Release("weights", attached);
+  TF_ASSERT_OK(second->Attach("weights", 8192, &attached, &created));
+  EXPECT_EQ(7, static_cast<char*>(attached)[0]);
+}
+
+TEST(SharedTensorArenaTest, ExclusiveHoldKeepsWritesFromThisProcess) {
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("exclusive"), &arena));
+  EXPECT_FALSE(arena->HoldExclusively("weights"));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("weights", 8192, &data, &created));
+  memset(data, 7, 8192);
+  arena->FinishFill("weights", data, Status::OK());
+
+  // Held twice, the bytes are already aliased.
+  void* other = nullptr;
+  TF_ASSERT_OK(arena->Attach("weights", 8192, &other, &created));
+  EXPECT_EQ(data, other);
+  EXPECT_FALSE(arena->HoldExclusively("weights"));
+  arena->Release("weights", other);
+
+  ASSERT_TRUE(arena->HoldExclusively("weights"));
+  EXPECT_TRUE(errors::IsAlreadyExists(
+      arena->Attach("weights", 8192, &other, &created)));
+  static_cast<char*>(data)[0] = 1;
+
+  // The writes go away with the exclusive hold.
+  arena->Release("weights", data);
+  TF_ASSERT_OK(arena->Attach("weights", 8192, &other, &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(7, static_cast<char*>(other)[0]);
+}
+
+TEST(SharedTensorArenaTest, TransparentHugePages) {
+  SharedTensorArena::Options options = TestOptions("huge_pages");
+  options.capacity_bytes = 16 << 20;
+  options.huge_pages = SharedTensorArena::HugePages::kTransparent;
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &arena));
+  EXPECT_EQ(SharedTensorArena::HugePages::kTransparent, arena->huge_pages());
+
+  void* small = nullptr;
+  void* large = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(arena->Attach("bias", 100, &small, &created));
+  TF_ASSERT_OK(arena->Attach("weights", (3 << 20) + 1, &large, &created));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % (2 << 20));
+  memset(large, 1, (3 << 20) + 1);
+  arena->FinishFill("weights", large, Status::OK());
+
+  SharedTensorArena::Stats stats = arena->GetStats();
+  EXPECT_EQ(4096 + (4 << 20), stats.allocated_bytes);
+  EXPECT_EQ(4 << 20, stats.huge_page_bytes);
+
+  // Fault the pages of the segment in.
+  int sum = 0;
+  for (int i = 0; i < (3 << 20); i += 4096) sum += static_cast<char*>(large)[i];
+  EXPECT_EQ(3 << 8, sum);
+  uint64 resident_bytes = 0;
+  uint64 huge_page_bytes = 0;
+  TF_ASSERT_OK(arena->GetHugePageCoverage(&resident_bytes, &huge_page_bytes));
+  EXPECT_GE(resident_bytes, 3 << 20);
+  EXPECT_LE(huge_page_bytes, resident_bytes);
+
+  // Other processes use the huge pages of the arena.
+  options.huge_pages = SharedTensorArena::HugePages::kNone;
+  std::unique_ptr<SharedTensorArena> other;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &other));
+  EXPECT_EQ(SharedTensorArena::HugePages::kTransparent, other->huge_pages());
+}
+
+TEST(SharedTensorArenaTest, NumaReplicas) {
+  SharedTensorArena::Options options = TestOptions("numa_replicas");
+  options.numa_replicas = true;
+  std::unique_ptr<SharedTensorArena> first, second, third;
+  options.numa_node = 0;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &first));
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &second));
+  options.numa_node = 1;
+  TF_ASSERT_OK(SharedTensorArena::Open(options, &third));
+  EXPECT_EQ(1, third->numa_node());
+
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(first->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+  first->FinishFill("weights", data, Status::OK());
+  TF_ASSERT_OK(second->Attach("weights", 100, &data, &created));
+  EXPECT_FALSE(created);
+  EXPECT_FALSE(third->Contains("weights"));
+  TF_ASSERT_OK(third->Attach("weights", 100, &data, &created));
+  EXPECT_TRUE(created);
+  third->FinishFill("weights", data, Status::OK());
+  EXPECT_EQ(2, first->NumHolders("weights"));
+  EXPECT_EQ(1, third->NumHolders("weights"));
+
+  SharedTensorArena::Stats stats = first->GetStats();
+  EXPECT_EQ(2, stats.num_segments);
+  ASSERT_EQ(2, stats.nodes.size());
+  EXPECT_EQ(4096, stats.nodes[0].allocated_bytes);
+  EXPECT_EQ(100, stats.nodes[0].saved_bytes);
+  EXPECT_EQ(4096, stats.nodes[1].allocated_bytes);
+  EXPECT_EQ(0, stats.nodes[1].saved_bytes);
+}
+
+TEST(SharedTensorArenaTest, ConnectToDaemon) {
+  std::unique_ptr<SharedTensorArena> daemon_arena;
+  TF_ASSERT_OK(SharedTensorArena::Open(TestOptions("daemon"), &daemon_arena));
+  void* data = nullptr;
+  bool created = false;
+  TF_ASSERT_OK(daemon_arena->Attach("weights", 100, &data, &created));
+  memset(data, 7, 100);
+  daemon_arena->FinishFill("weights", data, Status::OK());
+
+  const string socket_path = strings::StrCat(testing::TmpDir(), "/daemon.sock");
+  unlink(socket_path.c_str());
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_EQ(0, bind(listener, reinterpret_cast<struct sockaddr*>(&addr),
+                    sizeof(addr)));
+  ASSERT_EQ(0, listen(listener, 1));
+  std::thread daemon([&daemon_arena, listener] {
+    for (int i = 0; i < 2; ++i) {
+      const int connection = accept(listener, nullptr, nullptr);
+      TF_EXPECT_OK(daemon_arena->Serve(connection));
+      close(connection);
+    }
+  });
+
+  std::unique_ptr<SharedTensorArena> arena;
+  TF_ASSERT_OK(SharedTensorArena::Connect(
+      socket_path, SharedTensorArena::Options(), &arena));
+  TF_ASSERT_OK(arena->Attach("weights", 100, &data, &created));
+  EXPECT_FALSE(created);
+  EXPECT_EQ(7, static_cast<char*>(data)[99]);
+  EXPECT_EQ(2, daemon_arena->NumHolders("weights"));
+
+  const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(connection, reinterpret_cast<struct sockaddr*>(&addr),
+                       sizeof(addr)));
+  ASSERT_EQ(6, write(connection, "stats\n", 6));
+  string stats;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(connection, buf, sizeof(buf))) > 0) stats.append(buf, n);
+  close(connection);
+  EXPECT_NE(string::npos, stats.find("shared_tensor_arena_segments 1\n"));
+  EXPECT_NE(string::npos,
+            stats.find("shared_tensor_arena_node_saved_bytes{node=\"0\"} 100"));
+
+  daemon.join();
+  close(listener);
+}
+
+TEST(SharedTensorArenaTest, GlobalOverridesOnlyConfiguredOptions) {
+  setenv("TF_SHARED_TENSOR_HUGE_PAGES", "transparent", 1);
+  setenv("TF_SHARED_TENSOR_ARENA_PATH", "/nonexistent/tensor_arena", 1);
+  unsetenv("TF_SHARED_TENSOR_ARENA_SOCKET");
+  SharedTensorArena::Options options;
+  string socket_path;
+  SharedTensorArena::GlobalOptionsFromEnv(&options, &socket_path);
+  EXPECT_EQ(SharedTensorArena::HugePages::kTransparent, options.huge_pages);
+  EXPECT_TRUE(socket_path.empty());
+
+  // Configured like a server given a path flag: the path of the flag wins,
+  // the huge pages of the environment still apply.
+  const SharedTensorArena::Options test_options = TestOptions("global");
+  options.path = test_options.path;
+  options.capacity_bytes = 16 << 20;
+  options.index_capacity = test_options.index_capacity;
+  TF_ASSERT_OK(SharedTensorArena::ConfigureGlobal(options, socket_path));
+  SharedTensorArena* arena = SharedTensorArena::Global();
+  ASSERT_NE(nullptr, arena);
+  EXPECT_EQ(test_options.path, arena->path());
+  EXPECT_EQ(SharedTensorArena::HugePages::kTransparent, arena->huge_pages());
+  EXPECT_TRUE(errors::IsFailedPrecondition(
+      SharedTensorArena::ConfigureGlobal(options, socket_path)));
+}
+
+}  // namespace
+}  // namespace tensorflow
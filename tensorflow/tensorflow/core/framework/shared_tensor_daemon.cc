@@ -0,0 +1,175 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Owns the shared tensor arena of a node and hands it out over a Unix domain
+// socket, so that model servers only need the socket mounted:
+//
+//   shared_tensor_daemon --socket=/var/run/tetris/shared_tensors.sock
+//
+// and the model servers run with
+// TF_SHARED_TENSOR_ARENA_SOCKET=/var/run/tetris/shared_tensors.sock.
+// Reclaims the segments no process holds, and answers "stats" requests with
+// the usage of the arena, e.g. for the scheduler:
+//
+//   echo stats | nc -U /var/run/tetris/shared_tensors.sock
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/shared_tensor_arena.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char** argv) {
+  tensorflow::SharedTensorArena::Options options;
+  std::string socket_path = "/var/run/tetris/shared_tensors.sock";
+  std::string huge_pages = "none";
+  std::string file_mode = "0666";
+  tensorflow::int64 capacity_bytes = options.capacity_bytes;
+  tensorflow::int64 reclaim_grace_secs =
+      options.reclaim_grace_micros / 1000000;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("socket", &socket_path,
+                       "Unix domain socket to listen on"),
+      tensorflow::Flag("arena_path", &options.path, "Path of the arena file"),
+      tensorflow::Flag("capacity_bytes", &capacity_bytes,
+                       "Size of the data region of the arena"),
+      tensorflow::Flag("huge_pages", &huge_pages,
+                       "Pages backing the arena: none, transparent or "
+                       "hugetlbfs"),
+      tensorflow::Flag("reclaim_grace_secs", &reclaim_grace_secs,
+                       "How long a segment no process holds is kept"),
+      tensorflow::Flag("file_mode", &file_mode,
+                       "Octal permissions of the arena file and the socket. "
+                       "The model servers need to read and write both"),
+  };
+  bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  if (!parse_result || socket_path.empty()) {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return -1;
+  }
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+
+  using HugePages = tensorflow::SharedTensorArena::HugePages;
+  if (huge_pages == "none") {
+    options.huge_pages = HugePages::kNone;
+  } else if (huge_pages == "transparent") {
+    options.huge_pages = HugePages::kTransparent;
+  } else if (huge_pages == "hugetlbfs") {
+    options.huge_pages = HugePages::kHugetlbfs;
+  } else {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return -1;
+  }
+  char* file_mode_end = nullptr;
+  const unsigned long mode = strtoul(file_mode.c_str(), &file_mode_end, 8);
+  if (file_mode.empty() || *file_mode_end != '\0' || mode > 07777) {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return -1;
+  }
+  options.file_mode = mode;
+  options.capacity_bytes = capacity_bytes;
+  options.reclaim_grace_micros = reclaim_grace_secs * 1000000;
+
+  std::unique_ptr<tensorflow::SharedTensorArena> arena;
+  tensorflow::Status status =
+      tensorflow::SharedTensorArena::Open(options, &arena);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to open the shared tensor arena: " << status;
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    LOG(ERROR) << "Socket path too long: " << socket_path;
+    return 1;
+  }
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  unlink(socket_path.c_str());
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)) != 0 ||
+      chmod(socket_path.c_str(), options.file_mode) != 0 ||
+      listen(listener, 128) != 0) {
+    LOG(ERROR) << "Failed to listen on " << socket_path << ": "
+               << strerror(errno);
+    return 1;
+  }
+
+  tensorflow::SharedTensorArena* reclaimed = arena.get();
+  const tensorflow::int64 interval_micros = std::max<tensorflow::int64>(
+      options.reclaim_grace_micros / 2, 1000 * 1000);
+  std::unique_ptr<tensorflow::Thread> reclaimer(
+      tensorflow::Env::Default()->StartThread(
+          tensorflow::ThreadOptions(), "shared_tensor_reclaimer",
+          [reclaimed, interval_micros] {
+            while (true) {
+              tensorflow::Env::Default()->SleepForMicroseconds(
+                  interval_micros);
+              const tensorflow::int64 num_reclaimed = reclaimed->Reclaim();
+              if (num_reclaimed > 0) {
+                LOG(INFO) << "Reclaimed " << num_reclaimed
+                          << " shared tensors";
+              }
+            }
+          }));
+
+  LOG(INFO) << "Serving shared tensor arena " << arena->path() << " on "
+            << socket_path;
+  while (true) {
+    const int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      if (errno != EINTR) {
+        LOG(WARNING) << "Failed to accept a connection: " << strerror(errno);
+      }
+      continue;
+    }
+    // Requests and replies are small, and a process that does not send its
+    // request or read the reply within a second does not hold up the others
+    // for long.  Without the timeouts, it could block the daemon for good.
+    struct timeval timeout = {1, 0};
+    if (setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) != 0 ||
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                   sizeof(timeout)) != 0) {
+      LOG(WARNING) << "Failed to set the timeouts of a connection: "
+                   << strerror(errno);
+      close(connection);
+      continue;
+    }
+    status = arena->Serve(connection);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to serve a connection: " << status;
+    }
+    close(connection);
+  }
+}
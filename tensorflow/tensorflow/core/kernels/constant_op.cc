@@ -25,10 +25,12 @@ limitations under the License.
 #include "tensorflow/core/kernels/constant_op.h"
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.h"
@@ -38,7 +40,8 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_node_util.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/platform/macros.h"
-
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
 
 namespace tensorflow {
 
@@ -67,6 +70,62 @@ NodeDef StripTensorDataFromNodeDef(OpKernelConstruction* ctx) {
   return ret;
 }
 
+// Constants of at least this many bytes are placed in the node-wide shared
+// tensor arena, so that processes running graphs with the same weights baked
+// in as constants hold them once.  Negative disables sharing, and so does the
+// default SharedTensorPolicy: a constant does not know the bundle its graph
+// was loaded with, so the policies set for bundle paths do not apply.
+int64 SharedConstantMinBytes() {
+  static const int64 min_bytes = [] {
+    int64 value;
+    const Status s =
+        ReadInt64FromEnvVar("TF_SHARED_CONSTANT_MIN_BYTES", -1, &value);
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      return int64{-1};
+    }
+    return value;
+  }();
+  return min_bytes;
+}
+
+// Makes "*tensor" from "proto" in the shared tensor arena, under the content
+// key of its bytes.  Only the constants large enough to be worth it and held
+// in "tensor_content" are shared, the latter being hashed and copied without
+// parsing the proto into a private tensor first.  Constants held in the typed
+// "*_val" fields are never shared.  Returns false if the constant is not
+// shared.
+bool MakeSharedTensorFromProto(const TensorProto& proto, Tensor* tensor) {
+  const int64 min_bytes = SharedConstantMinBytes();
+  if (min_bytes < 0 || !GetSharedTensorPolicy("").enabled ||
+      !IsShareableDataType(proto.dtype()) ||
+      !TensorShape::IsValid(proto.tensor_shape())) {
+    return false;
+  }
+  const TensorShape shape(proto.tensor_shape());
+  const int64 num_bytes = shape.num_elements() * DataTypeSize(proto.dtype());
+  const StringPiece content = proto.tensor_content();
+  if (num_bytes <= 0 || num_bytes < min_bytes ||
+      content.size() != static_cast<size_t>(num_bytes)) {
+    return false;
+  }
+
+  const string key = SharedTensorKeyString(
+      ComputeSharedTensorKey(proto.dtype(), shape, content));
+  Allocator* allocator = cpu_allocator_base_mmap(key);
+  Tensor shared(allocator, proto.dtype(), shape);
+  if (!shared.IsInitialized()) return false;
+  if (allocator->MemNotExist()) {
+    void* data = DMAHelper::base(&shared);
+    memcpy(data, content.data(), num_bytes);
+    SharedTensorArena* arena = SharedTensorArena::Global();
+    if (arena != nullptr) arena->FinishFill(key, data, Status::OK());
+  }
+  VLOG(1) << "Shared constant of " << num_bytes << " bytes under " << key;
+  *tensor = std::move(shared);
+  return true;
+}
+
 }  // namespace
 
 ConstantOp::ConstantOp(OpKernelConstruction* ctx)
@@ -76,8 +135,11 @@ ConstantOp::ConstantOp(OpKernelConstruction* ctx)
   ScopedMemoryDebugAnnotation op_annotation(name_view().data());
   OP_REQUIRES_OK(ctx, ctx->GetAttr("value", &proto));
 
-  OP_REQUIRES_OK(ctx, ctx->device()->MakeTensorFromProto(
-                          *proto, AllocatorAttributes(), &tensor_));
+  if (ctx->device_type() != DEVICE_CPU ||
+      !MakeSharedTensorFromProto(*proto, &tensor_)) {
+    OP_REQUIRES_OK(ctx, ctx->device()->MakeTensorFromProto(
+                            *proto, AllocatorAttributes(), &tensor_));
+  }
   OP_REQUIRES(
       ctx, ctx->output_type(0) == tensor_.dtype(),
       errors::InvalidArgument("Type mismatch between value (",
@@ -96,6 +96,39 @@ TEST_F(ConstantOpTest, PersistentMemoryTracking) {
 #endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 }
 
+// Without TF_SHARED_CONSTANT_MIN_BYTES, identical constants get buffers of
+// their own.
+TEST_F(ConstantOpTest, IdenticalConstantsArePrivateByDefault) {
+  Tensor weights(DT_FLOAT, TensorShape({1024}));
+  weights.flat<float>().setConstant(1);
+  std::unique_ptr<Device> device(DeviceFactory::NewDevice(
+      "CPU", {}, "/job:worker/replica:0/task:0"));
+  std::vector<Tensor> outputs;
+  for (const string name : {"a", "b"}) {
+    NodeDef const_node;
+    TF_ASSERT_OK(NodeDefBuilder(name, "Const")
+                     .Attr("dtype", DT_FLOAT)
+                     .Attr("value", weights)
+                     .Finalize(&const_node));
+    Status status;
+    std::unique_ptr<OpKernel> op(CreateOpKernel(DEVICE_CPU, device.get(),
+                                                cpu_allocator(), const_node,
+                                                TF_GRAPH_DEF_VERSION, &status));
+    TF_ASSERT_OK(status);
+
+    OpKernelContext::Params params;
+    params.device = device.get();
+    params.frame_iter = FrameAndIter(0, 0);
+    params.op_kernel = op.get();
+    OpKernelContext ctx(&params);
+    op->Compute(&ctx);
+    TF_ASSERT_OK(ctx.status());
+    outputs.push_back(*ctx.mutable_output(0));
+  }
+  EXPECT_NE(outputs[0].tensor_data().data(), outputs[1].tensor_data().data());
+  EXPECT_EQ(1, outputs[1].flat<float>()(0));
+}
+
 // Returns graph containing "num" const nodes.  If 'sequential' is
 // true, make sure all constants are executed sequentially in the
 // graph by adding control dependencies.
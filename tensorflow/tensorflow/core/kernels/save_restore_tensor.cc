@@ -22,16 +22,21 @@ limitations under the License.
 #include <iostream>
 
 #include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
@@ -239,6 +244,31 @@ namespace {
 // Tensors larger than this threshold will be restored from a thread-pool.
 const int64 kLargeShapeThreshold = 16 << 20;  // 16M
 
+// Whether full tensors are restored as copy-on-write mappings of the
+// checkpoint data files where possible, sharing the page cache between
+// processes instead of copying them into the shared tensor arena.
+bool MapCheckpointTensors() {
+  static const bool map_tensors = [] {
+    bool value;
+    const Status s =
+        ReadBoolFromEnvVar("TF_MAP_CHECKPOINT_TENSORS", false, &value);
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      return false;
+    }
+    return value;
+  }();
+  return map_tensors;
+}
+
+// Returns true iff the buffer of "tensor" is a segment of the shared tensor
+// arena, as opposed to private memory it fell back to.
+bool IsInSharedTensorArena(const Tensor& tensor) {
+  const SharedTensorArena* arena = SharedTensorArena::GlobalIfOpen();
+  return arena != nullptr &&
+         arena->ContainsAddress(tensor.tensor_data().data());
+}
+
 // A restore operation for a single tensor.  Small tensors may be restored
 // directly from the op thread to improve read locality.  Large tensors can be
 // restored from a thread pool: this requires creating a separate BundleReader
@@ -268,12 +298,90 @@ struct RestoreOp {
     status = run(&reader);
   }
 
+  // Returns the key under which the restored tensor is shared with other
+  // processes, or an empty key if the tensor can not be shared.
   Status GetMmapID(BundleReader* reader,std::string *mmap_id) {
-
     CHECK(mmap_id != nullptr);
-    uint32 unmasked_crc_value = 0;
-    TF_RETURN_IF_ERROR(reader->GetUnmaskedCRC(tensor_name,&unmasked_crc_value));  
-    *mmap_id = std::to_string(unmasked_crc_value);
+    BundleEntryProto entry;
+    TF_RETURN_IF_ERROR(reader->LookupEntry(tensor_name, &entry));
+    *mmap_id = SharedTensorKeyForEntry(tensor_name, entry, shared_keys,
+                                       *shared_policy);
+    // Published without a content key: keep the checksum to verify whatever
+    // we attach to.
+    if (IsLegacySharedTensorKey(*mmap_id)) {
+      expected_crc32c = crc32c::Unmask(entry.crc32c());
+    }
+    return Status::OK();
+  }
+
+  // Checks the bytes of a tensor attached under a legacy key against the
+  // checkpoint.  On a mismatch, restores a private copy instead.
+  Status VerifyAttachedContent(BundleReader* reader, Tensor* restored_tensor) {
+    const StringPiece data = restored_tensor->tensor_data();
+    if (crc32c::Value(data.data(), data.size()) == expected_crc32c) {
+      return Status::OK();
+    }
+    LOG(WARNING) << "Shared tensor for " << tensor_name
+                 << " does not match the checkpoint, restoring privately";
+    return RestorePrivately(reader, restored_tensor);
+  }
+
+  // Replaces "*restored_tensor" by a private copy read from the checkpoint.
+  Status RestorePrivately(BundleReader* reader, Tensor* restored_tensor) {
+    Tensor private_tensor;
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        restored_tensor->dtype(), restored_tensor->shape(), &private_tensor));
+    TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, &private_tensor));
+    *restored_tensor = private_tensor;
+    return Status::OK();
+  }
+
+  // The model restoring the tensor, to label its metrics with.
+  string ModelName() const {
+    const SessionMetadata* session_metadata = context->session_metadata();
+    return session_metadata != nullptr && !session_metadata->name().empty()
+               ? session_metadata->name()
+               : reader_prefix;
+  }
+
+  // Exports whether a shareable tensor was attached, filled or restored
+  // privately, labelled with the model restoring it.
+  void RecordSharedRestore(const Tensor& restored_tensor, bool mem_not_exist,
+                           uint64 attach_us) {
+    const string model = ModelName();
+    const int64 num_bytes = restored_tensor.TotalBytes();
+    if (!IsInSharedTensorArena(restored_tensor)) {
+      metrics::RecordSharedTensorRestore(model, "private", num_bytes);
+    } else if (mem_not_exist) {
+      metrics::RecordSharedTensorRestore(model, "filled", num_bytes);
+    } else {
+      metrics::RecordSharedTensorRestore(model, "attached", num_bytes);
+      metrics::RecordSharedTensorAttachTime(attach_us);
+    }
+  }
+
+  // Sets the output to a mapping of the tensor in the checkpoint data file,
+  // if the shared tensor policy allows sharing it.  Returns false if the
+  // tensor can not be mapped, to be restored by a copy.
+  bool RestoreMapped(BundleReader* reader) {
+    if (!MapCheckpointTensors()) return false;
+    BundleEntryProto entry;
+    if (!reader->LookupEntry(tensor_name, &entry).ok() ||
+        SharedTensorKeyForEntry(tensor_name, entry, shared_keys,
+                                *shared_policy)
+            .empty()) {
+      return false;
+    }
+    Tensor mapped_tensor;
+    const Status s = reader->LookupMapped(tensor_name, &mapped_tensor);
+    if (!s.ok()) {
+      VLOG(1) << "Not mapping tensor " << tensor_name << ": " << s;
+      return false;
+    }
+    context->set_output(idx, mapped_tensor);
+    metrics::RecordSharedTensorRestore(ModelName(), "mapped",
+                                       mapped_tensor.TotalBytes());
+    return true;
   }
 
   Status run(BundleReader* reader) {
@@ -284,24 +392,58 @@ struct RestoreOp {
     VLOG(1) << "Restoring tensor " << idx << " : " << tensor_name << " : "
             << restored_full_shape.num_elements();
     Tensor* restored_tensor;
-    if (shape_and_slice.empty()) {
+    if (shape_and_slice.empty() && RestoreMapped(reader)) {
+      restored_tensor = context->mutable_output(idx);
+    } else if (shape_and_slice.empty()) {
       std::string mmap_id;
       TF_RETURN_IF_ERROR(GetMmapID(reader,&mmap_id));
 
-      // bool mem_not_exist = false;
-      bool mem_not_exist = true;
-
-      // Lookup the full tensor.
-      TF_RETURN_IF_ERROR(
-          context->allocate_output_mmap(idx, restored_full_shape, &restored_tensor,mmap_id,mem_not_exist));
-
-      if(mem_not_exist) {
+      if (mmap_id.empty()) {
+        TF_RETURN_IF_ERROR(context->allocate_output(idx, restored_full_shape,
+                                                    &restored_tensor));
         TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, restored_tensor));
-      }
+      } else {
+        bool mem_not_exist = true;
+
+        // Lookup the full tensor.
+        const uint64 attach_start_us = Env::Default()->NowMicros();
+        TF_RETURN_IF_ERROR(context->allocate_output_mmap(
+            idx, restored_full_shape, &restored_tensor, mmap_id,
+            mem_not_exist));
+        RecordSharedRestore(*restored_tensor, mem_not_exist,
+                            Env::Default()->NowMicros() - attach_start_us);
+        if (shared_policy->fail_if_not_shared &&
+            !IsInSharedTensorArena(*restored_tensor)) {
+          return errors::ResourceExhausted(
+              "Can not restore tensor ", tensor_name,
+              " into shared memory, and the shared tensor policy of ",
+              reader_prefix, " does not allow restoring it privately");
+        }
 
-      // TF_RETURN_IF_ERROR(
-      //     context->allocate_output(idx, restored_full_shape, &restored_tensor));
-      // TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, restored_tensor));
+        if(mem_not_exist) {
+          // Publish the outcome, so that the processes waiting for this
+          // tensor either attach to it or take the fill over.
+          Status lookup_status = reader->Lookup(tensor_name, restored_tensor);
+          SharedTensorArena* arena = SharedTensorArena::Global();
+          if (arena != nullptr) {
+            arena->FinishFill(mmap_id, restored_tensor->tensor_data().data(),
+                              lookup_status);
+          }
+          TF_RETURN_IF_ERROR(lookup_status);
+        } else if (IsLegacySharedTensorKey(mmap_id)) {
+          TF_RETURN_IF_ERROR(VerifyAttachedContent(reader, restored_tensor));
+        }
+        // The output may be forwarded and written in place, e.g. to the
+        // variable it is assigned to, so it must not alias another tensor of
+        // this process with the same content, e.g. an identical variable or
+        // a shared constant.
+        if (IsInSharedTensorArena(*restored_tensor) &&
+            !SharedTensorArena::GlobalIfOpen()->HoldExclusively(mmap_id)) {
+          VLOG(1) << "Shared tensor for " << tensor_name
+                  << " is in use in this process, restoring privately";
+          TF_RETURN_IF_ERROR(RestorePrivately(reader, restored_tensor));
+        }
+      }
     } else {
 
       // Lookup the slice.
@@ -351,6 +493,13 @@ struct RestoreOp {
   string tensor_name;
   string shape_and_slice;
   string reader_prefix;
+  // Content keys published with the bundle, if any.  Not owned.
+  const SharedTensorKeysProto* shared_keys;
+  // Not owned.
+  const SharedTensorPolicy* shared_policy;
+
+  // Unmasked crc32c of the tensor when shared under a legacy key.
+  uint32 expected_crc32c = 0;
 
   ::tensorflow::Status status;
 };
@@ -386,6 +535,11 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   BundleReader default_reader(Env::Default(), prefix_string);
   TF_RETURN_IF_ERROR(default_reader.status());
 
+  SharedTensorKeysProto shared_keys;
+  const bool has_shared_keys =
+      ReadSharedTensorKeys(Env::Default(), prefix_string, &shared_keys).ok();
+  const SharedTensorPolicy shared_policy = GetSharedTensorPolicy(prefix_string);
+
   std::vector<string> mismatched_errors;
   for (const size_t i : sorted_name_idx) {
     TensorShape restored_full_shape;
@@ -410,8 +564,13 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   for (auto i : sorted_name_idx) {
     const string& tensor_name = tensor_names_flat(i);
     const string& shape_and_slice = shape_and_slices_flat(i);
-    auto op =
-        new RestoreOp{context, i, tensor_name, shape_and_slice, prefix_string};
+    auto op = new RestoreOp{context,
+                            i,
+                            tensor_name,
+                            shape_and_slice,
+                            prefix_string,
+                            has_shared_keys ? &shared_keys : nullptr,
+                            &shared_policy};
     if (op->should_run_in_pool(&default_reader)) {
       pool_restore_ops.emplace_back(op);
     } else {
@@ -0,0 +1,130 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Tests of the constants shared through the shared tensor arena.  They live
+// apart from constant_op_test.cc as TF_SHARED_CONSTANT_MIN_BYTES is read once
+// per process.
+
+#include <stdlib.h>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int kMinBytes = 1024;
+
+class SharedConstantOpTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    setenv("TF_SHARED_CONSTANT_MIN_BYTES", std::to_string(kMinBytes).c_str(),
+           1 /* replace */);
+    SharedTensorArena::Options options;
+    options.path = io::JoinPath(testing::TmpDir(), "shared_constant_arena");
+    options.capacity_bytes = 1 << 20;
+    options.index_capacity = 16;
+    Env::Default()->DeleteFile(options.path).IgnoreError();
+    TF_CHECK_OK(SharedTensorArena::ConfigureGlobal(options, ""));
+  }
+
+  // Runs a Const kernel named "name" holding "value" and returns its output.
+  static Tensor RunConst(const string& name, const Tensor& value) {
+    NodeDef const_node;
+    TF_CHECK_OK(NodeDefBuilder(name, "Const")
+                    .Attr("dtype", value.dtype())
+                    .Attr("value", value)
+                    .Finalize(&const_node));
+    std::unique_ptr<Device> device(DeviceFactory::NewDevice(
+        "CPU", {}, "/job:worker/replica:0/task:0"));
+    Status status;
+    std::unique_ptr<OpKernel> op(CreateOpKernel(DEVICE_CPU, device.get(),
+                                                cpu_allocator(), const_node,
+                                                TF_GRAPH_DEF_VERSION, &status));
+    TF_CHECK_OK(status);
+
+    OpKernelContext::Params params;
+    params.device = device.get();
+    params.frame_iter = FrameAndIter(0, 0);
+    params.op_kernel = op.get();
+    OpKernelContext ctx(&params);
+    op->Compute(&ctx);
+    TF_CHECK_OK(ctx.status());
+    return *ctx.mutable_output(0);
+  }
+
+  static Tensor Weights(int num_bytes, float value) {
+    Tensor weights(DT_FLOAT, TensorShape({num_bytes / 4}));
+    weights.flat<float>().setConstant(value);
+    return weights;
+  }
+
+  static bool IsShared(const Tensor& tensor) {
+    const SharedTensorArena* arena = SharedTensorArena::GlobalIfOpen();
+    return arena != nullptr &&
+           arena->ContainsAddress(tensor.tensor_data().data());
+  }
+};
+
+TEST_F(SharedConstantOpTest, IdenticalConstantsShareOneSegment) {
+  const Tensor a = RunConst("a", Weights(kMinBytes, 1));
+  const Tensor b = RunConst("b", Weights(kMinBytes, 1));
+  const Tensor c = RunConst("c", Weights(kMinBytes, 2));
+  ASSERT_TRUE(IsShared(a));
+  EXPECT_EQ(a.tensor_data().data(), b.tensor_data().data());
+  EXPECT_TRUE(IsShared(c));
+  EXPECT_NE(a.tensor_data().data(), c.tensor_data().data());
+  EXPECT_EQ(1, a.flat<float>()(0));
+  EXPECT_EQ(2, c.flat<float>()(0));
+}
+
+TEST_F(SharedConstantOpTest, ConstantsBelowMinBytesArePrivate) {
+  const Tensor a = RunConst("a", Weights(kMinBytes / 2, 3));
+  const Tensor b = RunConst("b", Weights(kMinBytes / 2, 3));
+  EXPECT_FALSE(IsShared(a));
+  EXPECT_FALSE(IsShared(b));
+  EXPECT_NE(a.tensor_data().data(), b.tensor_data().data());
+  EXPECT_EQ(3, b.flat<float>()(0));
+}
+
+// A constant does not know the bundle of its graph, only the default policy
+// applies to it.
+TEST_F(SharedConstantOpTest, DefaultPolicyDisablesSharing) {
+  SharedTensorPolicy policy;
+  policy.enabled = false;
+  SetSharedTensorPolicy("", policy);
+  const Tensor a = RunConst("a", Weights(kMinBytes, 4));
+  const Tensor b = RunConst("b", Weights(kMinBytes, 4));
+  ClearSharedTensorPolicy("");
+  EXPECT_FALSE(IsShared(a));
+  EXPECT_NE(a.tensor_data().data(), b.tensor_data().data());
+}
+
+}  // namespace
+}  // namespace tensorflow
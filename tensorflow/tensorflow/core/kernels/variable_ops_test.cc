@@ -14,13 +14,18 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shared_tensor_arena.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
 namespace {
@@ -64,5 +69,154 @@ void BM_ManyManyVariablesManyThreads(int iters, int threads) {
 
 BENCHMARK(BM_ManyManyVariablesManyThreads)->Arg(50);
 
+Node* Constant(Graph* g, const string& name, const Tensor& value) {
+  Node* n;
+  TF_CHECK_OK(NodeBuilder(name, "Const")
+                  .Attr("dtype", value.dtype())
+                  .Attr("value", value)
+                  .Finalize(g, &n));
+  return n;
+}
+
+// Opens the shared tensor arena of this process, once for all the tests.
+SharedTensorArena* TestArena() {
+  static SharedTensorArena* arena = [] {
+    SharedTensorArena::Options arena_options;
+    arena_options.path =
+        io::JoinPath(testing::TmpDir(), "variable_ops_arena");
+    arena_options.capacity_bytes = 1 << 20;
+    arena_options.index_capacity = 16;
+    Env::Default()->DeleteFile(arena_options.path).IgnoreError();
+    TF_CHECK_OK(SharedTensorArena::ConfigureGlobal(arena_options, ""));
+    return SharedTensorArena::Global();
+  }();
+  return arena;
+}
+
+// Restoring a TF1 model assigns each restored tensor to an uninitialized
+// VariableV2.  The assignment has to reuse the buffer of the restored tensor,
+// or every process would end up with a private copy of the shared weights.
+TEST(VariableOpsTest, AssignReusesRestoredSharedTensor) {
+  SharedTensorArena* arena = TestArena();
+  ASSERT_NE(nullptr, arena);
+
+  const string prefix = io::JoinPath(testing::TmpDir(), "variable_ops_ckpt");
+  Tensor weights(DT_FLOAT, TensorShape({4}));
+  for (int i = 0; i < 4; ++i) weights.flat<float>()(i) = i + 1;
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("weights", weights));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  Graph g(OpRegistry::Global());
+  Tensor prefix_tensor(DT_STRING, TensorShape({}));
+  prefix_tensor.scalar<tstring>()() = prefix;
+  Tensor names(DT_STRING, TensorShape({1}));
+  names.flat<tstring>()(0) = "weights";
+  Tensor shape_and_slices(DT_STRING, TensorShape({1}));
+  shape_and_slices.flat<tstring>()(0) = "";
+  Node* restore;
+  TF_ASSERT_OK(NodeBuilder("restore", "RestoreV2")
+                   .Input(Constant(&g, "prefix", prefix_tensor))
+                   .Input(Constant(&g, "names", names))
+                   .Input(Constant(&g, "shape_and_slices", shape_and_slices))
+                   .Attr("dtypes", {DT_FLOAT})
+                   .Finalize(&g, &restore));
+  Node* variable;
+  TF_ASSERT_OK(NodeBuilder("weights", "VariableV2")
+                   .Attr("shape", TensorShape({4}))
+                   .Attr("dtype", DT_FLOAT)
+                   .Finalize(&g, &variable));
+  Node* assign;
+  TF_ASSERT_OK(NodeBuilder("assign", "Assign")
+                   .Input(variable)
+                   .Input(restore)
+                   .Finalize(&g, &assign));
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_ASSERT_OK(session->Create(gd));
+  TF_ASSERT_OK(session->Run({}, {}, {"assign"}, nullptr));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {"weights"}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(3, outputs[0].flat<float>()(2));
+  EXPECT_TRUE(arena->ContainsAddress(outputs[0].tensor_data().data()));
+}
+
+// Identical weights have the same content key.  Updating one of the
+// variables in place must leave the other alone.
+TEST(VariableOpsTest, UpdateDoesNotChangeIdenticalRestoredTensor) {
+  SharedTensorArena* arena = TestArena();
+  ASSERT_NE(nullptr, arena);
+
+  const string prefix =
+      io::JoinPath(testing::TmpDir(), "variable_ops_identical_ckpt");
+  Tensor weights(DT_FLOAT, TensorShape({4}));
+  for (int i = 0; i < 4; ++i) weights.flat<float>()(i) = i + 5;
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("a", weights));
+    TF_ASSERT_OK(writer.Add("b", weights));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  Graph g(OpRegistry::Global());
+  Tensor prefix_tensor(DT_STRING, TensorShape({}));
+  prefix_tensor.scalar<tstring>()() = prefix;
+  Tensor names(DT_STRING, TensorShape({2}));
+  names.flat<tstring>()(0) = "a";
+  names.flat<tstring>()(1) = "b";
+  Tensor shape_and_slices(DT_STRING, TensorShape({2}));
+  shape_and_slices.flat<tstring>()(0) = "";
+  shape_and_slices.flat<tstring>()(1) = "";
+  Node* restore;
+  TF_ASSERT_OK(NodeBuilder("restore", "RestoreV2")
+                   .Input(Constant(&g, "prefix", prefix_tensor))
+                   .Input(Constant(&g, "names", names))
+                   .Input(Constant(&g, "shape_and_slices", shape_and_slices))
+                   .Attr("dtypes", {DT_FLOAT, DT_FLOAT})
+                   .Finalize(&g, &restore));
+  std::vector<Node*> variables;
+  std::vector<string> assigns;
+  for (int i = 0; i < 2; ++i) {
+    const string name = names.flat<tstring>()(i);
+    Node* variable;
+    TF_ASSERT_OK(NodeBuilder(name, "VariableV2")
+                     .Attr("shape", TensorShape({4}))
+                     .Attr("dtype", DT_FLOAT)
+                     .Finalize(&g, &variable));
+    variables.push_back(variable);
+    Node* assign;
+    TF_ASSERT_OK(NodeBuilder(name + "/assign", "Assign")
+                     .Input(variable)
+                     .Input(restore, i)
+                     .Finalize(&g, &assign));
+    assigns.push_back(assign->name());
+  }
+  Tensor increment(DT_FLOAT, TensorShape({4}));
+  increment.flat<float>().setConstant(10);
+  Node* update;
+  TF_ASSERT_OK(NodeBuilder("a/update", "AssignAdd")
+                   .Input(variables[0])
+                   .Input(Constant(&g, "increment", increment))
+                   .Finalize(&g, &update));
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_ASSERT_OK(session->Create(gd));
+  TF_ASSERT_OK(session->Run({}, {}, assigns, nullptr));
+  TF_ASSERT_OK(session->Run({}, {}, {"a/update"}, nullptr));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, {"a", "b"}, {}, &outputs));
+  ASSERT_EQ(2, outputs.size());
+  EXPECT_EQ(17, outputs[0].flat<float>()(2));
+  EXPECT_EQ(7, outputs[1].flat<float>()(2));
+  EXPECT_NE(outputs[0].tensor_data().data(), outputs[1].tensor_data().data());
+}
+
 }  // namespace
 }  // namespace tensorflow
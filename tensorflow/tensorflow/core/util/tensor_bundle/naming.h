@@ -22,6 +22,7 @@ limitations under the License.
 //
 //   MetaFilename(prefix): pathname of the metadata file.
 //   DataFilename(prefix, shard_id, num_shards): pathname of a data file.
+//   SharedKeysFilename(prefix): pathname of the optional shared tensor keys.
 //
 // Typical usage includes forming a filepattern to match files on disk:
 //
@@ -41,6 +42,7 @@ namespace tensorflow {
 
 string MetaFilename(StringPiece prefix);
 string DataFilename(StringPiece prefix, int32 shard_id, int32 num_shards);
+string SharedKeysFilename(StringPiece prefix);
 
 }  // namespace tensorflow
 
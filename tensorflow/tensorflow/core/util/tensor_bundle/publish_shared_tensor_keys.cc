@@ -0,0 +1,76 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Computes the shared tensor keys of a checkpoint bundle and writes them next
+// to its ".index" file.  Run once per model version when it is published:
+//
+//   publish_shared_tensor_keys \
+//       --prefix=/models/vgg16/1/variables/variables
+//
+// With --data_alignment=4096 the bundle is first rewritten with its tensors
+// page aligned, so that they can be restored as mappings of the data file
+// (TF_MAP_CHECKPOINT_TENSORS=true).
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+#include "tensorflow/core/util/tensor_bundle/naming.h"
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+int main(int argc, char** argv) {
+  std::string prefix = "";
+  tensorflow::int32 data_alignment = 0;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("prefix", &prefix,
+                       "Prefix of the checkpoint bundle, e.g. "
+                       "<saved_model>/variables/variables"),
+      tensorflow::Flag("data_alignment", &data_alignment,
+                       "If positive, rewrites the bundle with its tensors "
+                       "aligned to this many bytes first, e.g. 4096"),
+  };
+  bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  if (!parse_result || prefix.empty()) {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return -1;
+  }
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+
+  if (data_alignment > 0) {
+    tensorflow::Status status = tensorflow::RealignBundle(
+        tensorflow::Env::Default(), prefix, data_alignment);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to realign " << prefix << ": " << status;
+      return 1;
+    }
+    LOG(INFO) << "Aligned tensors of " << prefix << " to " << data_alignment
+              << " bytes";
+  }
+
+  tensorflow::Status status =
+      tensorflow::WriteSharedTensorKeys(tensorflow::Env::Default(), prefix);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to publish shared tensor keys for " << prefix << ": "
+               << status;
+    return 1;
+  }
+  LOG(INFO) << "Wrote " << tensorflow::SharedKeysFilename(prefix);
+  return 0;
+}
@@ -0,0 +1,243 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
+
+#include <map>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/saved_tensor_slice_util.h"
+#include "tensorflow/core/util/tensor_bundle/naming.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+
+const char* const kLegacySharedTensorKeyPrefix = "crc-";
+
+namespace {
+
+// Returns true iff "key" is the bundle key of a slice of a partitioned
+// tensor, as opposed to the name of a full tensor.  Slices are only ever
+// restored privately, through the entry of their full tensor.
+bool IsTensorSliceKey(StringPiece key) {
+  string name;
+  TensorSlice slice;
+  return checkpoint::DecodeTensorNameSlice(string(key), &name, &slice).ok();
+}
+
+// Fingerprints everything but the bytes of a tensor.  Mixed into the content
+// fingerprint so that equal bytes reinterpreted with another dtype or shape
+// yield another key.
+uint64 FingerprintDtypeAndShape(DataType dtype, const TensorShape& shape) {
+  string meta = strings::StrCat(static_cast<int>(dtype), ":");
+  for (int d = 0; d < shape.dims(); ++d) {
+    strings::StrAppend(&meta, shape.dim_size(d), ",");
+  }
+  return Fingerprint64(meta);
+}
+
+// The policies set with SetSharedTensorPolicy(), by path.
+struct SharedTensorPolicies {
+  mutex mu;
+  std::map<string, SharedTensorPolicy> by_path TF_GUARDED_BY(mu);
+};
+
+SharedTensorPolicies* GetSharedTensorPolicies() {
+  static SharedTensorPolicies* policies = new SharedTensorPolicies;
+  return policies;
+}
+
+// Returns true iff "prefix" is "path" or a path under it.
+bool IsUnderPath(StringPiece prefix, StringPiece path) {
+  if (!absl::StartsWith(prefix, path)) return false;
+  return prefix.size() == path.size() || path.back() == '/' ||
+         prefix[path.size()] == '/';
+}
+
+}  // namespace
+
+bool IsShareableDataType(DataType dtype) {
+  return DataTypeCanUseMemcpy(dtype) && !IsRefType(dtype);
+}
+
+SharedTensorKeyProto ComputeSharedTensorKey(const Tensor& val) {
+  return ComputeSharedTensorKey(val.dtype(), val.shape(), val.tensor_data());
+}
+
+SharedTensorKeyProto ComputeSharedTensorKey(DataType dtype,
+                                            const TensorShape& shape,
+                                            StringPiece data) {
+  DCHECK(IsShareableDataType(dtype));
+  const uint64 meta = FingerprintDtypeAndShape(dtype, shape);
+  const Fprint128 content = Fingerprint128(data);
+
+  SharedTensorKeyProto key;
+  key.set_high(FingerprintCat64(meta, content.high64));
+  key.set_low(FingerprintCat64(meta, content.low64));
+  key.set_num_bytes(data.size());
+  return key;
+}
+
+string SharedTensorKeyString(const SharedTensorKeyProto& key) {
+  return strings::Printf("%016llx%016llx",
+                         static_cast<unsigned long long>(key.high()),
+                         static_cast<unsigned long long>(key.low()));
+}
+
+string LegacySharedTensorKey(const BundleEntryProto& entry) {
+  const uint64 meta =
+      FingerprintDtypeAndShape(entry.dtype(), TensorShape(entry.shape()));
+  return strings::Printf("%s%08x%016llx%llx", kLegacySharedTensorKeyPrefix,
+                         entry.crc32c(), static_cast<unsigned long long>(meta),
+                         static_cast<unsigned long long>(entry.size()));
+}
+
+bool IsLegacySharedTensorKey(StringPiece key) {
+  return absl::StartsWith(key, kLegacySharedTensorKeyPrefix);
+}
+
+void SetSharedTensorPolicy(StringPiece path, const SharedTensorPolicy& policy) {
+  SharedTensorPolicies* policies = GetSharedTensorPolicies();
+  mutex_lock l(policies->mu);
+  policies->by_path[string(path)] = policy;
+}
+
+void ClearSharedTensorPolicy(StringPiece path) {
+  SharedTensorPolicies* policies = GetSharedTensorPolicies();
+  mutex_lock l(policies->mu);
+  policies->by_path.erase(string(path));
+}
+
+SharedTensorPolicy GetSharedTensorPolicy(StringPiece prefix) {
+  SharedTensorPolicies* policies = GetSharedTensorPolicies();
+  mutex_lock l(policies->mu);
+  const SharedTensorPolicy* best = nullptr;
+  size_t best_length = 0;
+  for (const auto& entry : policies->by_path) {
+    const string& path = entry.first;
+    if ((best == nullptr || path.size() > best_length) &&
+        (path.empty() || IsUnderPath(prefix, path))) {
+      best = &entry.second;
+      best_length = path.size();
+    }
+  }
+  return best != nullptr ? *best : SharedTensorPolicy();
+}
+
+string SharedTensorKeyForEntry(StringPiece name, const BundleEntryProto& entry,
+                               const SharedTensorKeysProto* published_keys,
+                               const SharedTensorPolicy& policy) {
+  if (!policy.enabled ||
+      static_cast<int64>(entry.size()) < policy.min_tensor_bytes) {
+    return "";
+  }
+  if (published_keys != nullptr) {
+    const auto it = published_keys->keys().find(string(name));
+    if (it != published_keys->keys().end()) {
+      const SharedTensorKeyProto& key = it->second;
+      if (key.num_bytes() == static_cast<int64>(entry.size()) &&
+          key.crc32c() == entry.crc32c()) {
+        return SharedTensorKeyString(key);
+      }
+      // The keys were published for another version of the bundle.  Sharing
+      // under them would serve, or store, other bytes than the entry holds.
+      LOG(WARNING) << "Published shared tensor key of " << name
+                   << " does not match its bundle entry, ignoring it";
+    }
+  }
+  if (entry.slices().empty() && IsShareableDataType(entry.dtype())) {
+    return LegacySharedTensorKey(entry);
+  }
+  return "";
+}
+
+Status ListSharedTensors(Env* env, StringPiece prefix,
+                         std::vector<SharedTensorInfo>* tensors) {
+  BundleReader reader(env, prefix);
+  TF_RETURN_IF_ERROR(reader.status());
+  SharedTensorKeysProto published_keys;
+  const bool has_published_keys =
+      ReadSharedTensorKeys(env, prefix, &published_keys).ok();
+  const SharedTensorPolicy policy = GetSharedTensorPolicy(prefix);
+
+  tensors->clear();
+  for (reader.Seek(kHeaderEntryKey); reader.Valid(); reader.Next()) {
+    if (reader.key() == kHeaderEntryKey || IsTensorSliceKey(reader.key())) {
+      continue;
+    }
+    BundleEntryProto entry;
+    const StringPiece value = reader.value();
+    if (!entry.ParseFromArray(value.data(), value.size())) {
+      return errors::DataLoss("Can not parse the bundle entry of ",
+                              reader.key());
+    }
+    SharedTensorInfo info;
+    info.key = SharedTensorKeyForEntry(
+        reader.key(), entry, has_published_keys ? &published_keys : nullptr,
+        policy);
+    if (info.key.empty()) continue;
+    info.name = string(reader.key());
+    info.num_bytes = entry.size();
+    tensors->push_back(std::move(info));
+  }
+  return Status::OK();
+}
+
+Status WriteSharedTensorKeys(Env* env, StringPiece prefix) {
+  BundleReader reader(env, prefix);
+  TF_RETURN_IF_ERROR(reader.status());
+
+  // Lookup() repositions the reader, so collect the names first.
+  std::vector<string> names;
+  for (reader.Seek(kHeaderEntryKey); reader.Valid(); reader.Next()) {
+    if (reader.key() == kHeaderEntryKey || IsTensorSliceKey(reader.key())) {
+      continue;
+    }
+    names.emplace_back(reader.key());
+  }
+
+  SharedTensorKeysProto keys;
+  for (const string& name : names) {
+    BundleEntryProto entry;
+    TF_RETURN_IF_ERROR(reader.LookupEntry(name, &entry));
+    if (!entry.slices().empty() || !IsShareableDataType(entry.dtype())) {
+      continue;
+    }
+    Tensor val(entry.dtype(), TensorShape(entry.shape()));
+    TF_RETURN_IF_ERROR(reader.Lookup(name, &val));
+    SharedTensorKeyProto* key = &(*keys.mutable_keys())[name];
+    *key = ComputeSharedTensorKey(val);
+    key->set_crc32c(entry.crc32c());
+  }
+  return WriteBinaryProto(env, SharedKeysFilename(prefix), keys);
+}
+
+Status ReadSharedTensorKeys(Env* env, StringPiece prefix,
+                            SharedTensorKeysProto* keys) {
+  const string filename = SharedKeysFilename(prefix);
+  TF_RETURN_IF_ERROR(env->FileExists(filename));
+  return ReadBinaryProto(env, filename, keys);
+}
+
+}  // namespace tensorflow
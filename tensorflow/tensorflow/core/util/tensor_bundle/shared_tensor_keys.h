@@ -0,0 +1,140 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Content-addressed keys for tensors restored into node-wide shared memory.
+//
+// A restored tensor is shared between processes under a key.  The key of a
+// tensor is a 128-bit fingerprint over its dtype, its shape and its bytes, so
+// two tensors only ever share memory if their contents are identical.  The keys
+// are computed once when a model is published and stored next to the ".index"
+// file of the bundle:
+//
+//   /models/vgg16/1/variables/
+//       variables.index
+//       variables.data-00000-of-00001
+//       variables.shared_keys
+//
+// Publishing a bundle:
+//
+//   TF_RETURN_IF_ERROR(WriteSharedTensorKeys(env, prefix));
+//
+// Bundles published without keys still share their tensors under a key derived
+// from the entry metadata (see LegacySharedTensorKey()), whose content has to
+// be verified against the stored crc32c on every attach.
+
+#ifndef TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_SHARED_TENSOR_KEYS_H_
+#define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_SHARED_TENSOR_KEYS_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/tensor_bundle.pb.h"
+
+namespace tensorflow {
+
+// Prefix of the keys returned by LegacySharedTensorKey().
+extern const char* const kLegacySharedTensorKeyPrefix;
+
+// Returns true iff tensors of "dtype" can be placed in shared memory, i.e.
+// their buffers are plain bytes and hold no pointers.
+bool IsShareableDataType(DataType dtype);
+
+// Computes the content key of "val".
+// REQUIRES: IsShareableDataType(val.dtype())
+SharedTensorKeyProto ComputeSharedTensorKey(const Tensor& val);
+
+// Computes the content key of a tensor of "dtype" and "shape" whose buffer
+// holds "data", e.g. the "tensor_content" of a TensorProto.
+// REQUIRES: IsShareableDataType(dtype)
+SharedTensorKeyProto ComputeSharedTensorKey(DataType dtype,
+                                            const TensorShape& shape,
+                                            StringPiece data);
+
+// Returns the name of the shared segment holding the tensor keyed by "key".
+string SharedTensorKeyString(const SharedTensorKeyProto& key);
+
+// Returns the name of the shared segment for a tensor of a bundle published
+// without shared keys.  The name is derived from the crc32c, dtype, shape and
+// size stored in "entry" and starts with kLegacySharedTensorKeyPrefix.  It is
+// not content-addressed: callers must verify the bytes of an attached segment
+// against "entry.crc32c()".
+string LegacySharedTensorKey(const BundleEntryProto& entry);
+
+// Returns true iff "key" was returned by LegacySharedTensorKey().
+bool IsLegacySharedTensorKey(StringPiece key);
+
+// Which tensors of a bundle are restored into shared memory.
+struct SharedTensorPolicy {
+  bool enabled = true;
+  // Smaller tensors are restored privately: their segments would cost more
+  // syscalls and index entries than they save.
+  int64 min_tensor_bytes = 0;
+  // Whether a tensor that can not be placed in shared memory, e.g. because the
+  // arena is full or unavailable, fails the restore instead of being restored
+  // into private memory.
+  bool fail_if_not_shared = false;
+};
+
+// Sets the policy of the bundles whose prefix is under "path", e.g. the base
+// path of a model.  The policy of an empty "path" is the default one.
+void SetSharedTensorPolicy(StringPiece path, const SharedTensorPolicy& policy);
+
+// Drops the policy set for "path", which falls back to the default one.
+void ClearSharedTensorPolicy(StringPiece path);
+
+// Returns the policy of the bundle at "prefix": the one set for the longest
+// path it is under, or the default one.
+SharedTensorPolicy GetSharedTensorPolicy(StringPiece prefix);
+
+// Returns the name of the shared segment the tensor "name" of a bundle, stored
+// as "entry", is restored into: its published key if "published_keys" has
+// one matching the size and crc32c of "entry", otherwise its legacy key if it
+// is unsliced and of a shareable type.
+// Returns an empty string if the tensor is restored privately, which it also
+// is if "policy" rules it out.  "published_keys" may be null.
+string SharedTensorKeyForEntry(StringPiece name, const BundleEntryProto& entry,
+                               const SharedTensorKeysProto* published_keys,
+                               const SharedTensorPolicy& policy);
+
+// A tensor of a bundle that is restored into shared memory.
+struct SharedTensorInfo {
+  string name;
+  // As returned by SharedTensorKeyForEntry().
+  string key;
+  uint64 num_bytes = 0;
+};
+
+// Lists the tensors of the bundle at "prefix" that are restored into shared
+// memory under GetSharedTensorPolicy(prefix), without reading their data.
+// Partitioned tensors, restored privately slice by slice, are not listed.
+Status ListSharedTensors(Env* env, StringPiece prefix,
+                         std::vector<SharedTensorInfo>* tensors);
+
+// Reads every tensor of the bundle at "prefix" and writes their content keys to
+// SharedKeysFilename(prefix).  Meant to be run once when a model is published.
+Status WriteSharedTensorKeys(Env* env, StringPiece prefix);
+
+// Reads the keys written by WriteSharedTensorKeys().  Returns a NotFound error
+// if the bundle at "prefix" was published without shared keys.
+Status ReadSharedTensorKeys(Env* env, StringPiece prefix,
+                            SharedTensorKeysProto* keys);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_SHARED_TENSOR_KEYS_H_
@@ -0,0 +1,255 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/tensor_bundle/shared_tensor_keys.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace {
+
+string Prefix(const string& prefix) {
+  return strings::StrCat(testing::TmpDir(), "/", prefix);
+}
+
+bool SameKey(const SharedTensorKeyProto& a, const SharedTensorKeyProto& b) {
+  return a.high() == b.high() && a.low() == b.low() &&
+         a.num_bytes() == b.num_bytes();
+}
+
+TEST(SharedTensorKeysTest, KeyDependsOnContent) {
+  Tensor a = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor b = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor c = test::AsTensor<float>({1, 2, 3, 5});
+  EXPECT_TRUE(SameKey(ComputeSharedTensorKey(a), ComputeSharedTensorKey(b)));
+  EXPECT_FALSE(SameKey(ComputeSharedTensorKey(a), ComputeSharedTensorKey(c)));
+  EXPECT_EQ(16, ComputeSharedTensorKey(a).num_bytes());
+}
+
+TEST(SharedTensorKeysTest, KeyDependsOnDtypeAndShape) {
+  Tensor flat = test::AsTensor<int32>({0, 0, 0, 0});
+  Tensor square = test::AsTensor<int32>({0, 0, 0, 0}, TensorShape({2, 2}));
+  Tensor other_dtype = test::AsTensor<float>({0, 0, 0, 0});
+  EXPECT_FALSE(
+      SameKey(ComputeSharedTensorKey(flat), ComputeSharedTensorKey(square)));
+  EXPECT_FALSE(SameKey(ComputeSharedTensorKey(flat),
+                       ComputeSharedTensorKey(other_dtype)));
+}
+
+TEST(SharedTensorKeysTest, KeyOfRawContent) {
+  Tensor t = test::AsTensor<float>({1, 2, 3, 4}, TensorShape({2, 2}));
+  EXPECT_TRUE(SameKey(ComputeSharedTensorKey(t),
+                      ComputeSharedTensorKey(DT_FLOAT, TensorShape({2, 2}),
+                                             t.tensor_data())));
+}
+
+TEST(SharedTensorKeysTest, KeyString) {
+  SharedTensorKeyProto key;
+  key.set_high(0x0123456789abcdefULL);
+  key.set_low(0xfULL);
+  EXPECT_EQ("0123456789abcdef000000000000000f", SharedTensorKeyString(key));
+  EXPECT_FALSE(IsLegacySharedTensorKey(SharedTensorKeyString(key)));
+}
+
+TEST(SharedTensorKeysTest, LegacyKey) {
+  BundleEntryProto entry;
+  entry.set_dtype(DT_FLOAT);
+  entry.mutable_shape()->add_dim()->set_size(4);
+  entry.set_size(16);
+  entry.set_crc32c(42);
+  const string key = LegacySharedTensorKey(entry);
+  EXPECT_TRUE(IsLegacySharedTensorKey(key));
+
+  entry.mutable_shape()->mutable_dim(0)->set_size(2);
+  entry.mutable_shape()->add_dim()->set_size(2);
+  EXPECT_NE(key, LegacySharedTensorKey(entry));
+}
+
+TEST(SharedTensorKeysTest, ShareableDataTypes) {
+  EXPECT_TRUE(IsShareableDataType(DT_FLOAT));
+  EXPECT_TRUE(IsShareableDataType(DT_INT64));
+  EXPECT_FALSE(IsShareableDataType(DT_STRING));
+  EXPECT_FALSE(IsShareableDataType(DT_VARIANT));
+  EXPECT_FALSE(IsShareableDataType(DT_RESOURCE));
+}
+
+TEST(SharedTensorKeysTest, WriteAndRead) {
+  const string prefix = Prefix("shared_keys");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({1, 2, 3})));
+    TF_ASSERT_OK(writer.Add("names", test::AsTensor<tstring>({"a", "b"})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  SharedTensorKeysProto keys;
+  EXPECT_TRUE(errors::IsNotFound(
+      ReadSharedTensorKeys(Env::Default(), prefix, &keys)));
+
+  TF_ASSERT_OK(WriteSharedTensorKeys(Env::Default(), prefix));
+  TF_ASSERT_OK(ReadSharedTensorKeys(Env::Default(), prefix, &keys));
+  ASSERT_EQ(1, keys.keys_size());
+  ASSERT_EQ(1, keys.keys().count("weights"));
+  EXPECT_TRUE(SameKey(ComputeSharedTensorKey(test::AsTensor<float>({1, 2, 3})),
+                      keys.keys().at("weights")));
+}
+
+TEST(SharedTensorKeysTest, ListSharedTensors) {
+  const string prefix = Prefix("list_shared");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("bias", test::AsTensor<float>({1, 2})));
+    TF_ASSERT_OK(writer.Add("names", test::AsTensor<tstring>({"a", "b"})));
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({1, 2, 3})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  std::vector<SharedTensorInfo> tensors;
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  ASSERT_EQ(2, tensors.size());
+  EXPECT_EQ("bias", tensors[0].name);
+  EXPECT_TRUE(IsLegacySharedTensorKey(tensors[0].key));
+  EXPECT_EQ(8, tensors[0].num_bytes);
+  EXPECT_EQ("weights", tensors[1].name);
+  EXPECT_EQ(12, tensors[1].num_bytes);
+
+  TF_ASSERT_OK(WriteSharedTensorKeys(Env::Default(), prefix));
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  ASSERT_EQ(2, tensors.size());
+  EXPECT_EQ(SharedTensorKeyString(
+                ComputeSharedTensorKey(test::AsTensor<float>({1, 2}))),
+            tensors[0].key);
+}
+
+TEST(SharedTensorKeysTest, ListSharedTensorsSkipsPartitionedTensors) {
+  const string prefix = Prefix("list_partitioned");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("bias", test::AsTensor<float>({1, 2})));
+    const TensorShape full_shape({4});
+    TF_ASSERT_OK(writer.AddSlice("weights", full_shape,
+                                 TensorSlice::ParseOrDie("0,2"),
+                                 test::AsTensor<float>({1, 2})));
+    TF_ASSERT_OK(writer.AddSlice("weights", full_shape,
+                                 TensorSlice::ParseOrDie("2,2"),
+                                 test::AsTensor<float>({3, 4})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  std::vector<SharedTensorInfo> tensors;
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  ASSERT_EQ(1, tensors.size());
+  EXPECT_EQ("bias", tensors[0].name);
+
+  TF_ASSERT_OK(WriteSharedTensorKeys(Env::Default(), prefix));
+  SharedTensorKeysProto keys;
+  TF_ASSERT_OK(ReadSharedTensorKeys(Env::Default(), prefix, &keys));
+  EXPECT_EQ(1, keys.keys_size());
+}
+
+TEST(SharedTensorKeysTest, StaleKeysAreIgnored) {
+  const string prefix = Prefix("stale_keys");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({1, 2, 3})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  TF_ASSERT_OK(WriteSharedTensorKeys(Env::Default(), prefix));
+  SharedTensorKeysProto keys;
+  TF_ASSERT_OK(ReadSharedTensorKeys(Env::Default(), prefix, &keys));
+
+  // Saved again with other weights, without publishing the keys again.
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({4, 5, 6})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), prefix);
+  TF_ASSERT_OK(reader.status());
+  BundleEntryProto entry;
+  TF_ASSERT_OK(reader.LookupEntry("weights", &entry));
+  const string key = SharedTensorKeyForEntry("weights", entry, &keys,
+                                             SharedTensorPolicy());
+  EXPECT_EQ(LegacySharedTensorKey(entry), key);
+
+  std::vector<SharedTensorInfo> tensors;
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  ASSERT_EQ(1, tensors.size());
+  EXPECT_TRUE(IsLegacySharedTensorKey(tensors[0].key));
+
+  // A key of another size is not trusted either.
+  TF_ASSERT_OK(WriteSharedTensorKeys(Env::Default(), prefix));
+  TF_ASSERT_OK(ReadSharedTensorKeys(Env::Default(), prefix, &keys));
+  EXPECT_FALSE(IsLegacySharedTensorKey(
+      SharedTensorKeyForEntry("weights", entry, &keys, SharedTensorPolicy())));
+  (*keys.mutable_keys())["weights"].set_num_bytes(16);
+  EXPECT_EQ(LegacySharedTensorKey(entry),
+            SharedTensorKeyForEntry("weights", entry, &keys,
+                                    SharedTensorPolicy()));
+}
+
+TEST(SharedTensorKeysTest, Policy) {
+  SharedTensorPolicy disabled;
+  disabled.enabled = false;
+  SharedTensorPolicy large_only;
+  large_only.min_tensor_bytes = 10;
+  SetSharedTensorPolicy("/models/a", disabled);
+  SetSharedTensorPolicy("/models/a/2", large_only);
+
+  EXPECT_TRUE(GetSharedTensorPolicy("/models/b/1/variables").enabled);
+  EXPECT_FALSE(GetSharedTensorPolicy("/models/a/1/variables").enabled);
+  EXPECT_FALSE(GetSharedTensorPolicy("/models/a").enabled);
+  EXPECT_TRUE(GetSharedTensorPolicy("/models/ab/1/variables").enabled);
+  EXPECT_EQ(10,
+            GetSharedTensorPolicy("/models/a/2/variables").min_tensor_bytes);
+
+  SetSharedTensorPolicy("", disabled);
+  EXPECT_FALSE(GetSharedTensorPolicy("/models/b/1/variables").enabled);
+  ClearSharedTensorPolicy("");
+  ClearSharedTensorPolicy("/models/a");
+  ClearSharedTensorPolicy("/models/a/2");
+  EXPECT_TRUE(GetSharedTensorPolicy("/models/a/1/variables").enabled);
+}
+
+TEST(SharedTensorKeysTest, ListSharedTensorsUnderPolicy) {
+  const string prefix = Prefix("list_policy");
+  {
+    BundleWriter writer(Env::Default(), prefix);
+    TF_ASSERT_OK(writer.Add("bias", test::AsTensor<float>({1, 2})));
+    TF_ASSERT_OK(writer.Add("weights", test::AsTensor<float>({1, 2, 3})));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  SharedTensorPolicy policy;
+  policy.min_tensor_bytes = 10;
+  SetSharedTensorPolicy(prefix, policy);
+  std::vector<SharedTensorInfo> tensors;
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  ASSERT_EQ(1, tensors.size());
+  EXPECT_EQ("weights", tensors[0].name);
+
+  policy.enabled = false;
+  SetSharedTensorPolicy(prefix, policy);
+  TF_ASSERT_OK(ListSharedTensors(Env::Default(), prefix, &tensors));
+  EXPECT_TRUE(tensors.empty());
+  ClearSharedTensorPolicy(prefix);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,12 +15,19 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <utility>
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -41,6 +48,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/platform/error.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
@@ -403,6 +411,74 @@ Status PadAlignment(FileOutputBuffer* out, int alignment, int64* size) {
   return status;
 }
 
+// A copy-on-write mapping of a whole data file.  Its pages are those of the
+// page cache, shared with every process mapping the file, until this process
+// writes to them and gets private copies.  The file itself is never written.
+class CopyOnWriteFileRegion : public ReadOnlyMemoryRegion {
+ public:
+  CopyOnWriteFileRegion(void* address, uint64 length)
+      : address_(address), length_(length) {}
+  ~CopyOnWriteFileRegion() override { munmap(address_, length_); }
+
+  const void* data() override { return address_; }
+  uint64 length() override { return length_; }
+
+ private:
+  void* const address_;
+  const uint64 length_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CopyOnWriteFileRegion);
+};
+
+// Maps the local file "filename" copy-on-write.
+Status MapFileCopyOnWrite(const string& filename,
+                          std::unique_ptr<ReadOnlyMemoryRegion>* region) {
+  const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return IOError("Failed to open " + filename, errno);
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    const int error = errno;
+    close(fd);
+    return IOError("Failed to stat " + filename, error);
+  }
+  // Writable so that kernels may update the tensors in place, which only
+  // ever touches private copies of the pages.
+  void* address = mmap(nullptr, statbuf.st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+  const int error = errno;
+  close(fd);
+  if (address == MAP_FAILED) {
+    return IOError("Failed to map " + filename, error);
+  }
+  region->reset(new CopyOnWriteFileRegion(address, statbuf.st_size));
+  return Status::OK();
+}
+
+// A tensor buffer pointing into a copy-on-write mapping of a data file.  Like
+// any buffer it owns, kernels may forward it, e.g. to the variable a restored
+// tensor is assigned to, and write to it in place.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     uint64 offset, size_t size)
+      : TensorBuffer(const_cast<char*>(
+            static_cast<const char*>(region->data()) + offset)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("mapped_bundle");
+    proto->set_ptr(reinterpret_cast<uintptr_t>(data()));
+  }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
 }  // namespace
 
 BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
@@ -739,6 +815,55 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
   return status;
 }
 
+Status RealignBundle(Env* env, StringPiece prefix, int data_alignment) {
+  if (data_alignment < 1) {
+    return errors::InvalidArgument("Invalid data alignment: ", data_alignment);
+  }
+  BundleReader reader(env, prefix);
+  TF_RETURN_IF_ERROR(reader.status());
+
+  const string tmp_prefix = strings::StrCat(prefix, "_realign_tmp");
+  BundleWriter::Options options;
+  options.data_alignment = data_alignment;
+  Status status;
+  {
+    BundleWriter writer(env, tmp_prefix, options);
+    for (reader.Seek(kHeaderEntryKey), reader.Next();
+         status.ok() && reader.Valid(); reader.Next()) {
+      BundleEntryProto entry;
+      status = ParseEntryProto(reader.key(), reader.value(), &entry);
+      if (status.ok() && !entry.slices().empty()) {
+        status = errors::Unimplemented("Can not realign partitioned tensor ",
+                                       reader.key(), " in bundle ", prefix);
+      }
+      Tensor val;
+      if (status.ok()) status = reader.ReadCurrent(&val);
+      if (status.ok()) status = writer.Add(reader.key(), val);
+    }
+    if (status.ok()) status = writer.Finish();
+  }
+  if (!status.ok()) {
+    env->DeleteFile(DataFilename(tmp_prefix, 0, 1)).IgnoreError();
+    env->DeleteFile(MetaFilename(tmp_prefix)).IgnoreError();
+    return status;
+  }
+
+  std::vector<string> old_data_files;
+  TF_RETURN_IF_ERROR(env->GetMatchingPaths(
+      strings::StrCat(prefix, ".data-*-of-*"), &old_data_files));
+  const string data_file = DataFilename(prefix, 0, 1);
+  TF_RETURN_IF_ERROR(
+      env->RenameFile(DataFilename(tmp_prefix, 0, 1), data_file));
+  TF_RETURN_IF_ERROR(
+      env->RenameFile(MetaFilename(tmp_prefix), MetaFilename(prefix)));
+  for (const string& old_data_file : old_data_files) {
+    if (old_data_file != data_file) {
+      env->DeleteFile(old_data_file).IgnoreError();
+    }
+  }
+  return Status::OK();
+}
+
 // Interface for reading a tensor bundle.
 
 BundleReader::BundleReader(Env* env, StringPiece prefix)
@@ -936,14 +1061,6 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   return Status::OK();
 }
 
-Status BundleReader::GetUnmaskedCRC(StringPiece key,uint32 *unmasked_crc_value) {
-  CHECK(unmasked_crc_value != nullptr);
-  BundleEntryProto entry;
-  TF_RETURN_IF_ERROR(GetBundleEntryProto(key, &entry));
-  *unmasked_crc_value = crc32c::Unmask(entry.crc32c());
-  return Status::OK();
-}
-
 Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
@@ -958,6 +1075,48 @@ Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   }
 }
 
+Status BundleReader::LookupMapped(StringPiece key, Tensor* val) {
+  CHECK(val != nullptr);
+  BundleEntryProto entry;
+  TF_RETURN_IF_ERROR(GetBundleEntryProto(key, &entry));
+  if (!entry.slices().empty() || !DataTypeCanUseMemcpy(entry.dtype()) ||
+      need_to_swap_bytes_ ||
+      entry.offset() % Allocator::kAllocatorAlignment != 0) {
+    return errors::FailedPrecondition("Tensor ", key, " in bundle ", prefix_,
+                                      " can not be mapped");
+  }
+  const TensorShape shape(entry.shape());
+  const uint64 num_bytes = shape.num_elements() * DataTypeSize(entry.dtype());
+  if (static_cast<uint64>(entry.size()) != num_bytes) {
+    return errors::DataLoss("Invalid size in bundle entry: key ", key,
+                            "; stored size ", entry.size(),
+                            "; expected size ", num_bytes);
+  }
+  if (num_bytes == 0) {
+    *val = Tensor(entry.dtype(), shape);
+    return Status::OK();
+  }
+
+  std::shared_ptr<ReadOnlyMemoryRegion>& region =
+      mapped_data_[entry.shard_id()];
+  if (region == nullptr) {
+    std::unique_ptr<ReadOnlyMemoryRegion> new_region;
+    TF_RETURN_IF_ERROR(MapFileCopyOnWrite(
+        DataFilename(prefix_, entry.shard_id(), num_shards_), &new_region));
+    region = std::move(new_region);
+  }
+  if (entry.offset() + num_bytes > region->length()) {
+    return errors::DataLoss("TensorBundle at ", prefix_, " shard ",
+                            entry.shard_id(), " is too short for tensor ", key);
+  }
+
+  MappedTensorBuffer* buf =
+      new MappedTensorBuffer(region, entry.offset(), num_bytes);
+  *val = Tensor(entry.dtype(), shape, buf);
+  buf->Unref();
+  return Status::OK();
+}
+
 Status BundleReader::ReadCurrent(Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
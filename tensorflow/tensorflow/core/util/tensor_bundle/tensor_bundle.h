@@ -62,6 +62,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -176,6 +177,14 @@ class BundleWriter {
 Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
                     StringPiece merged_prefix);
 
+// Rewrites the bundle at "prefix" into a single shard with its tensors aligned
+// to "data_alignment" bytes, e.g. so that BundleReader::LookupMapped() can map
+// them.  Partitioned tensors are not supported.
+//
+// The data file and then the metadata file are replaced by renames, so the
+// bundle must not be read while it is rewritten.
+Status RealignBundle(Env* env, StringPiece prefix, int data_alignment);
+
 // On construction, silently attempts to read the metadata associated with
 // "prefix".  If caller intends to call any function afterwards, "status()"
 // must be checked.
@@ -219,6 +228,22 @@ class BundleReader {
   // REQUIRES: status().ok()
   Status Lookup(StringPiece key, Tensor* val) TF_MUST_USE_RESULT;
 
+  // Looks up the tensor keyed by "key" like "Lookup()", but without copying
+  // it: "val" is backed by a copy-on-write mapping of the data file, so every
+  // process mapping the same bundle shares the pages of the page cache until
+  // it writes to them.  The data file is never modified.  Neither the stored
+  // crc32c checksum is validated nor the pages read up front; they are
+  // faulted in as the tensor is used.  The mapping lives as long as any
+  // tensor backed by it, independently of this reader.
+  //
+  // Returns FailedPrecondition if the tensor can not be mapped: partitioned,
+  // not of a memcpy-able dtype, of a different endianness, or stored at an
+  // offset that is not a multiple of Allocator::kAllocatorAlignment.  Returns
+  // an IOError if the data file is not a local file that can be mapped.  The
+  // caller is expected to fall back to "Lookup()" then.
+  // REQUIRES: status().ok()
+  Status LookupMapped(StringPiece key, Tensor* val) TF_MUST_USE_RESULT;
+
   // Looks up the tensor pointed to by the internal iterator.
   //
   // On error, "val" may contain nonsense data.
@@ -263,7 +288,13 @@ class BundleReader {
 
   string DebugString();
 
-  Status GetUnmaskedCRC(StringPiece key,uint32 *unmasked_crc_value);
+  // Looks up the metadata proto of the tensor keyed by "key": its dtype, shape,
+  // location in the data files and crc32c checksum.
+  // REQUIRES: status().ok()
+  Status LookupEntry(StringPiece key,
+                     BundleEntryProto* entry) TF_MUST_USE_RESULT {
+    return GetBundleEntryProto(key, entry);
+  }
 
  private:
   // Seeks for "key" and reads the metadata proto.
@@ -295,6 +326,10 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32, io::InputBuffer*> data_;
+  // Copy-on-write mappings of the data files, opened by "LookupMapped()".
+  // Shared with the tensors backed by them.
+  std::unordered_map<int32, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
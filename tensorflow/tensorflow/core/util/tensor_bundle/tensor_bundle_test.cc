@@ -1109,6 +1109,79 @@ TEST_F(TensorBundleAlignmentTest, AlignmentTest) {
   }
 }
 
+TEST_F(TensorBundleAlignmentTest, LookupMapped) {
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = 64;
+    BundleWriter writer(Env::Default(), Prefix("mapped"), opts);
+    TF_EXPECT_OK(writer.Add("foo_000", Constant_2x3<float>(0)));
+    TF_EXPECT_OK(writer.Add("foo_001", Constant_2x3<int64>(1)));
+    TF_EXPECT_OK(writer.Add("strings", Constant_2x3<tstring>("a")));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  Tensor foo_000;
+  Tensor foo_001;
+  {
+    BundleReader reader(Env::Default(), Prefix("mapped"));
+    TF_ASSERT_OK(reader.status());
+    TF_ASSERT_OK(reader.LookupMapped("foo_000", &foo_000));
+    TF_ASSERT_OK(reader.LookupMapped("foo_001", &foo_001));
+    Tensor strings;
+    EXPECT_TRUE(errors::IsFailedPrecondition(
+        reader.LookupMapped("strings", &strings)));
+  }
+  // The mapping outlives the reader.
+  test::ExpectTensorEqual<float>(Constant_2x3<float>(0), foo_000);
+  test::ExpectTensorEqual<int64>(Constant_2x3<int64>(1), foo_001);
+  EXPECT_TRUE(foo_000.IsAligned());
+
+  // The tensor may be updated in place, e.g. once forwarded to a variable,
+  // without the bundle changing.
+  EXPECT_TRUE(foo_000.RefCountIsOne());
+  foo_000.flat<float>()(0) = 42;
+  BundleReader reader(Env::Default(), Prefix("mapped"));
+  TF_ASSERT_OK(reader.status());
+  Tensor val(DT_FLOAT, TensorShape({2, 3}));
+  TF_ASSERT_OK(reader.Lookup("foo_000", &val));
+  test::ExpectTensorEqual<float>(Constant_2x3<float>(0), val);
+}
+
+TEST_F(TensorBundleAlignmentTest, LookupMappedRequiresAlignment) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("unaligned"));
+    TF_EXPECT_OK(writer.Add("foo_000", Constant(true, TensorShape({3}))));
+    TF_EXPECT_OK(writer.Add("foo_001", Constant_2x3<float>(1)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), Prefix("unaligned"));
+  TF_ASSERT_OK(reader.status());
+  Tensor val;
+  EXPECT_TRUE(
+      errors::IsFailedPrecondition(reader.LookupMapped("foo_001", &val)));
+}
+
+TEST_F(TensorBundleAlignmentTest, RealignBundle) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("realign"));
+    TF_EXPECT_OK(writer.Add("foo_000", Constant(true, TensorShape({3}))));
+    TF_EXPECT_OK(writer.Add("foo_001", Constant_2x3<float>(1)));
+    TF_EXPECT_OK(writer.Add("foo_002", Constant_2x3<tstring>("a")));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  TF_ASSERT_OK(RealignBundle(Env::Default(), Prefix("realign"), 4096));
+  {
+    BundleReader reader(Env::Default(), Prefix("realign"));
+    TF_ASSERT_OK(reader.status());
+    Expect<bool>(&reader, "foo_000", Constant(true, TensorShape({3})));
+    Expect<float>(&reader, "foo_001", Constant_2x3<float>(1));
+    Expect<tstring>(&reader, "foo_002", Constant_2x3<tstring>("a"));
+    ExpectAlignment<float>(&reader, "foo_001", 4096);
+    Tensor val;
+    TF_ASSERT_OK(reader.LookupMapped("foo_001", &val));
+    test::ExpectTensorEqual<float>(Constant_2x3<float>(1), val);
+  }
+}
+
 static void BM_BundleAlignmentByteOff(int iters, int alignment,
                                       int tensor_size) {
   testing::StopTiming();